@@ -61,6 +61,16 @@ void yield(void);
 #define FALLING 2
 #define RISING 3
 
+#define CLOCK_DIV1   0
+#define CLOCK_DIV2   1
+#define CLOCK_DIV4   2
+#define CLOCK_DIV8   3
+#define CLOCK_DIV16  4
+#define CLOCK_DIV32  5
+#define CLOCK_DIV64  6
+#define CLOCK_DIV128 7
+#define CLOCK_DIV256 8
+
 #if defined(__AVR_ATmega64__) || defined(__AVR_ATmega128__)
 #define EXTERNAL 1
 #define INTERNAL 2
@@ -131,6 +141,22 @@ void analogWrite(uint8_t, int);
 unsigned long millis(void);
 unsigned long micros(void);
 void delay(unsigned long);
+void idle(unsigned long ms);
+void enableTimer2Crystal(void);
+void rtcBegin(void);
+unsigned long rtcTime(void);
+void rtcSetTime(unsigned long seconds);
+unsigned int rtcSubseconds(void);
+void rtcSetAlarm(unsigned long seconds, void (*callback)(void));
+void rtcClearAlarm(void);
+uint8_t rtcAlarmSet(void);
+uint8_t calibrateOscillator(void);
+uint8_t trimOscillator(void);
+void setClockDivider(uint8_t divider);
+uint8_t getClockDivider(void);
+unsigned long cpuFrequency(void);
+uint8_t attachClockChange(void (*callback)(void));
+void detachClockChange(void (*callback)(void));
 void delayMicroseconds(unsigned int us);
 unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout);
 unsigned long pulseInLong(uint8_t pin, uint8_t state, unsigned long timeout);
@@ -140,6 +166,8 @@ uint8_t shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder);
 
 void attachInterrupt(uint8_t, void (*)(void), int mode);
 void detachInterrupt(uint8_t);
+void attachPinChangeInterrupt(uint8_t pin, void (*)(void), int mode);
+void detachPinChangeInterrupt(uint8_t pin);
 
 void setup(void);
 void loop(void);
@@ -244,6 +272,8 @@ extern const uint8_t PROGMEM digital_pin_to_timer_PGM[];
 #include "HardwareSerial.h"
 #include "USBAPI.h"
 #include "wiring_extras.h"
+#include "Task.h"
+#include "Thread.h"
 
 #if defined(HAVE_HWSERIAL0) && defined(HAVE_CDCSERIAL)
 #error "Targets with both UART0 and CDC serial not supported"
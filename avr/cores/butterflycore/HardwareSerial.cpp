@@ -60,6 +60,40 @@
   bool Serial3_available() __attribute__((weak));
 #endif
 
+// attachClockChange() is weakly referenced as well, so begin() doesn't pull
+// in the clock scaling code for sketches that never change the clock.
+// Serialx_clock_changed() sets the baud rate again for the new clock
+extern "C" uint8_t attachClockChange(void (*callback)(void)) __attribute__((weak));
+
+#if defined(HAVE_HWSERIAL0)
+  void Serial0_clock_changed() __attribute__((weak));
+#endif
+#if defined(HAVE_HWSERIAL1)
+  void Serial1_clock_changed() __attribute__((weak));
+#endif
+#if defined(HAVE_HWSERIAL2)
+  void Serial2_clock_changed() __attribute__((weak));
+#endif
+#if defined(HAVE_HWSERIAL3)
+  void Serial3_clock_changed() __attribute__((weak));
+#endif
+
+static void serialClockChanged(void)
+{
+#if defined(HAVE_HWSERIAL0)
+  if (Serial0_clock_changed) Serial0_clock_changed();
+#endif
+#if defined(HAVE_HWSERIAL1)
+  if (Serial1_clock_changed) Serial1_clock_changed();
+#endif
+#if defined(HAVE_HWSERIAL2)
+  if (Serial2_clock_changed) Serial2_clock_changed();
+#endif
+#if defined(HAVE_HWSERIAL3)
+  if (Serial3_clock_changed) Serial3_clock_changed();
+#endif
+}
+
 void serialEventRun(void)
 {
 #if defined(HAVE_HWSERIAL0)
@@ -82,8 +116,8 @@ void HardwareSerial::_tx_udr_empty_irq(void)
 {
   // If interrupts are enabled, there must be more data in the output
   // buffer. Send the next byte
-  unsigned char c = _tx_buffer[_tx_buffer_tail];
-  _tx_buffer_tail = (_tx_buffer_tail + 1) % SERIAL_TX_BUFFER_SIZE;
+  unsigned char c;
+  _tx_buffer.pop(c);
 
   *_udr = c;
 
@@ -92,7 +126,7 @@ void HardwareSerial::_tx_udr_empty_irq(void)
   // actually got written
   sbi(*_ucsra, TXC0);
 
-  if (_tx_buffer_head == _tx_buffer_tail) {
+  if (_tx_buffer.empty()) {
     // Buffer empty, so disable interrupts
     cbi(*_ucsrb, UDRIE0);
   }
@@ -100,10 +134,12 @@ void HardwareSerial::_tx_udr_empty_irq(void)
 
 // Public Methods //////////////////////////////////////////////////////////////
 
-void HardwareSerial::begin(unsigned long baud, byte config)
+void HardwareSerial::_set_baud(void)
 {
+  unsigned long clock = cpuFrequency();
+
   // Try u2x mode first
-  uint16_t baud_setting = (F_CPU / 4 / baud - 1) / 2;
+  uint16_t baud_setting = (clock / 4 / _baud - 1) / 2;
   *_ucsra = 1 << U2X0;
 
   // hardcoded exception for 57600 for compatibility with the bootloader
@@ -111,15 +147,29 @@ void HardwareSerial::begin(unsigned long baud, byte config)
   // on the 8U2 on the Uno and Mega 2560. Also, The baud_setting cannot
   // be > 4095, so switch back to non-u2x mode if the baud rate is too
   // low.
-  if (((F_CPU == 16000000UL) && (baud == 57600)) || (baud_setting >4095))
+  if (((clock == 16000000UL) && (_baud == 57600)) || (baud_setting >4095))
   {
     *_ucsra = 0;
-    baud_setting = (F_CPU / 8 / baud - 1) / 2;
+    baud_setting = (clock / 8 / _baud - 1) / 2;
   }
 
   // assign the baud_setting, a.k.a. ubrr (USART Baud Rate Register)
   *_ubrrh = baud_setting >> 8;
   *_ubrrl = baud_setting;
+}
+
+void HardwareSerial::_clock_changed(void)
+{
+  if (*_ucsrb & (_BV(RXEN0) | _BV(TXEN0)))
+    _set_baud();
+}
+
+void HardwareSerial::begin(unsigned long baud, byte config)
+{
+  _baud = baud;
+  _set_baud();
+  if (attachClockChange)
+    attachClockChange(serialClockChanged);
 
   _written = false;
 
@@ -146,48 +196,37 @@ void HardwareSerial::end()
   cbi(*_ucsrb, UDRIE0);
   
   // clear any received data
-  _rx_buffer_head = _rx_buffer_tail;
+  _rx_buffer.clear();
 }
 
 int HardwareSerial::available(void)
 {
-  return ((unsigned int)(SERIAL_RX_BUFFER_SIZE + _rx_buffer_head - _rx_buffer_tail)) % SERIAL_RX_BUFFER_SIZE;
+  return _rx_buffer.available();
 }
 
 int HardwareSerial::peek(void)
 {
-  if (_rx_buffer_head == _rx_buffer_tail) {
+  if (_rx_buffer.empty()) {
     return -1;
   } else {
-    return _rx_buffer[_rx_buffer_tail];
+    return _rx_buffer.peek();
   }
 }
 
 int HardwareSerial::read(void)
 {
   // if the head isn't ahead of the tail, we don't have any characters
-  if (_rx_buffer_head == _rx_buffer_tail) {
+  unsigned char c;
+  if (!_rx_buffer.pop(c)) {
     return -1;
   } else {
-    unsigned char c = _rx_buffer[_rx_buffer_tail];
-    _rx_buffer_tail = (rx_buffer_index_t)(_rx_buffer_tail + 1) % SERIAL_RX_BUFFER_SIZE;
     return c;
   }
 }
 
 int HardwareSerial::availableForWrite(void)
 {
-#if (SERIAL_TX_BUFFER_SIZE>256)
-  uint8_t oldSREG = SREG;
-  cli();
-#endif
-  tx_buffer_index_t head = _tx_buffer_head;
-  tx_buffer_index_t tail = _tx_buffer_tail;
-#if (SERIAL_TX_BUFFER_SIZE>256)
-  SREG = oldSREG;
-#endif
-  if (head >= tail) return SERIAL_TX_BUFFER_SIZE - 1 - head + tail;
-  return tail - head - 1;
+  return _tx_buffer.space();
 }
 
 void HardwareSerial::flush()
@@ -199,12 +238,17 @@ void HardwareSerial::flush()
     return;
 
   while (bit_is_set(*_ucsrb, UDRIE0) || bit_is_clear(*_ucsra, TXC0)) {
-    if (bit_is_clear(SREG, SREG_I) && bit_is_set(*_ucsrb, UDRIE0))
+    if (bit_is_clear(SREG, SREG_I)) {
+      if (bit_is_set(*_ucsrb, UDRIE0))
 	// Interrupts are globally disabled, but the DR empty
 	// interrupt should be enabled, so poll the DR empty flag to
 	// prevent deadlock
 	if (bit_is_set(*_ucsra, UDRE0))
 	  _tx_udr_empty_irq();
+    } else {
+      // let any tasks run while the interrupt handler sends the rest
+      yield();
+    }
   }
   // If we get here, nothing is queued anymore (DRIE is disabled) and
   // the hardware finished tranmission (TXC is set).
@@ -217,16 +261,14 @@ size_t HardwareSerial::write(uint8_t c)
   // to the data register and be done. This shortcut helps
   // significantly improve the effective datarate at high (>
   // 500kbit/s) bitrates, where interrupt overhead becomes a slowdown.
-  if (_tx_buffer_head == _tx_buffer_tail && bit_is_set(*_ucsra, UDRE0)) {
+  if (_tx_buffer.empty() && bit_is_set(*_ucsra, UDRE0)) {
     *_udr = c;
     sbi(*_ucsra, TXC0);
     return 1;
   }
-  tx_buffer_index_t i = (_tx_buffer_head + 1) % SERIAL_TX_BUFFER_SIZE;
-	
   // If the output buffer is full, there's nothing for it other than to 
   // wait for the interrupt handler to empty it a bit
-  while (i == _tx_buffer_tail) {
+  while (_tx_buffer.full()) {
     if (bit_is_clear(SREG, SREG_I)) {
       // Interrupts are disabled, so we'll have to poll the data
       // register empty flag ourselves. If it is set, pretend an
@@ -235,12 +277,13 @@ size_t HardwareSerial::write(uint8_t c)
       if(bit_is_set(*_ucsra, UDRE0))
 	_tx_udr_empty_irq();
     } else {
-      // nop, the interrupt handler will free up space for us
+      // nop, the interrupt handler will free up space for us. Don't
+      // yield() here: a task writing to this port would take the slot
+      // this write is waiting for
     }
   }
 
-  _tx_buffer[_tx_buffer_head] = c;
-  _tx_buffer_head = i;
+  _tx_buffer.push(c);
 	
   sbi(*_ucsrb, UDRIE0);
   
@@ -27,18 +27,13 @@
 #include <inttypes.h>
 
 #include "Stream.h"
+#include "RingBuffer.h"
 
-// Define constants and variables for buffering incoming serial data.  We're
-// using a ring buffer (I think), in which head is the index of the location
-// to which to write the next incoming character and tail is the index of the
-// location from which to read.
-// NOTE: a "power of 2" buffer size is reccomended to dramatically
-//       optimize all the modulo operations for ring buffers.
-// WARNING: When buffer sizes are increased to > 256, the buffer index
-// variables are automatically increased in size, but the extra
-// atomicity guards needed for that are not implemented. This will
-// often work, but occasionally a race condition can occur that makes
-// Serial behave erratically. See https://github.com/arduino/Arduino/issues/2405
+// Define constants and variables for buffering incoming serial data. The
+// interrupt handlers and the sketch pass data through a RingBuffer each
+// way, so the buffer sizes must be powers of 2. Above 128 bytes the
+// buffer indices are words, which RingBuffer reads and writes with
+// interrupts off.
 #if !defined(SERIAL_TX_BUFFER_SIZE)
 #if ((RAMEND - RAMSTART) < 1023)
 #define SERIAL_TX_BUFFER_SIZE 16
@@ -53,16 +48,8 @@
 #define SERIAL_RX_BUFFER_SIZE 64
 #endif
 #endif
-#if (SERIAL_TX_BUFFER_SIZE>256)
-typedef uint16_t tx_buffer_index_t;
-#else
-typedef uint8_t tx_buffer_index_t;
-#endif
-#if  (SERIAL_RX_BUFFER_SIZE>256)
-typedef uint16_t rx_buffer_index_t;
-#else
-typedef uint8_t rx_buffer_index_t;
-#endif
+typedef RingBuffer<SERIAL_TX_BUFFER_SIZE>::index_t tx_buffer_index_t;
+typedef RingBuffer<SERIAL_RX_BUFFER_SIZE>::index_t rx_buffer_index_t;
 
 // Define config for Serial.begin(baud, config);
 #define SERIAL_5N1 0x00
@@ -101,17 +88,14 @@ class HardwareSerial : public Stream
     volatile uint8_t * const _udr;
     // Has any byte been written to the UART since begin()
     bool _written;
-
-    volatile rx_buffer_index_t _rx_buffer_head;
-    volatile rx_buffer_index_t _rx_buffer_tail;
-    volatile tx_buffer_index_t _tx_buffer_head;
-    volatile tx_buffer_index_t _tx_buffer_tail;
+    // Baud rate from begin(), to set again when the CPU clock changes
+    unsigned long _baud;
 
     // Don't put any members after these buffers, since only the first
-    // 32 bytes of this struct can be accessed quickly using the ldd
+    // 64 bytes of this struct can be accessed quickly using the ldd
     // instruction.
-    unsigned char _rx_buffer[SERIAL_RX_BUFFER_SIZE];
-    unsigned char _tx_buffer[SERIAL_TX_BUFFER_SIZE];
+    RingBuffer<SERIAL_RX_BUFFER_SIZE> _rx_buffer;
+    RingBuffer<SERIAL_TX_BUFFER_SIZE> _tx_buffer;
 
   public:
     inline HardwareSerial(
@@ -137,6 +121,11 @@ class HardwareSerial : public Stream
     // Interrupt handlers - Not intended to be called externally
     inline void _rx_complete_irq(void);
     void _tx_udr_empty_irq(void);
+    // Called after setClockDivider() - Not intended to be called externally
+    void _clock_changed(void);
+
+  private:
+    void _set_baud(void);
 };
 
 #if defined(UBRRH) || defined(UBRR0H)
@@ -76,4 +76,8 @@ bool Serial0_available() {
   return Serial.available();
 }
 
+void Serial0_clock_changed() {
+  Serial._clock_changed();
+}
+
 #endif // HAVE_HWSERIAL0
@@ -66,4 +66,8 @@ bool Serial1_available() {
   return Serial1.available();
 }
 
+void Serial1_clock_changed() {
+  Serial1._clock_changed();
+}
+
 #endif // HAVE_HWSERIAL1
@@ -54,4 +54,8 @@ bool Serial2_available() {
   return Serial2.available();
 }
 
+void Serial2_clock_changed() {
+  Serial2._clock_changed();
+}
+
 #endif // HAVE_HWSERIAL2
@@ -54,4 +54,8 @@ bool Serial3_available() {
   return Serial3.available();
 }
 
+void Serial3_clock_changed() {
+  Serial3._clock_changed();
+}
+
 #endif // HAVE_HWSERIAL3
@@ -0,0 +1,179 @@
+/*
+  RingBuffer.h - single producer, single consumer ring buffer
+  Part of ButterflyCore
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+/*
+ * A ring buffer for passing data between an interrupt and the sketch:
+ * one side only ever pushes and the other only pops, and neither has to
+ * turn interrupts off for it.
+ *
+ * The head and tail count up freely and are masked when the buffer is
+ * indexed, so all size slots can be used and the count is head - tail.
+ * That takes a size that's a power of two, and indices twice as wide:
+ * a byte up to a size of 128, or a word above that. A word can't be read
+ * or written in one go, so then the indices are copied with interrupts
+ * off.
+ *
+ *   RingBuffer<64> rx;
+ *
+ *   ISR(...)        { rx.push(UDR0); }
+ *   void loop()     { uint8_t c; while (rx.pop(c)) ... }
+ *
+ * readSpan() and writeSpan() hand out the longest run of slots that
+ * doesn't wrap, to work on in place and then consume() or commit().
+ *
+ * It is meant for a stream of data from one side to the other. Wire's
+ * buffers are filled and then emptied whole by the same side, and have to
+ * be one run of memory for twi_readFrom() and twi_writeTo(); the LCD's
+ * TextBuffer is a string the scrolling indexes by position. Both keep
+ * plain arrays.
+ */
+
+#ifndef RingBuffer_h
+#define RingBuffer_h
+
+#include <inttypes.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+template <bool wide> struct RingBufferIndex { typedef uint8_t type; };
+template <> struct RingBufferIndex<true> { typedef uint16_t type; };
+
+template <uint16_t size, typename T = uint8_t>
+class RingBuffer
+{
+  static_assert(size >= 2 && size <= 32768 && !(size & (size - 1)),
+                "RingBuffer size must be a power of two");
+
+public:
+  typedef typename RingBufferIndex<(size > 128)>::type index_t;
+
+  RingBuffer() : _head(0), _tail(0) {}
+
+  // Producer side
+
+  bool push(T value)
+  {
+    index_t head = _head;
+
+    if ((index_t)(head - load(_tail)) == size)
+      return false;
+    _data[head & (size - 1)] = value;
+    publish(_head, head + 1);
+    return true;
+  }
+
+  // Free slots, some of them maybe past the end of the array
+  index_t space() const { return size - count(); }
+  bool full() const { return count() == size; }
+
+  // Free slots at *data up to the end of the array; fill them, then
+  // commit() the ones that were used
+  index_t writeSpan(T *&data)
+  {
+    index_t head = _head, i = head & (size - 1);
+    index_t n = size - (index_t)(head - load(_tail));
+
+    barrier();
+    data = &_data[i];
+    return n < size - i ? n : size - i;
+  }
+
+  void commit(index_t n) { publish(_head, _head + n); }
+
+  // Consumer side
+
+  bool pop(T &value)
+  {
+    index_t tail = _tail;
+
+    if (load(_head) == tail)
+      return false;
+    barrier();
+    value = _data[tail & (size - 1)];
+    publish(_tail, tail + 1);
+    return true;
+  }
+
+  // The next value, if not empty()
+  T peek() const { barrier(); return _data[_tail & (size - 1)]; }
+
+  index_t available() const { return count(); }
+  bool empty() const { return count() == 0; }
+
+  // Drop everything pushed so far
+  void clear() { publish(_tail, load(_head)); }
+
+  // Values at *data up to the end of the array; use them, then consume()
+  // as many
+  index_t readSpan(const T *&data)
+  {
+    index_t tail = _tail, i = tail & (size - 1);
+    index_t n = (index_t)(load(_head) - tail);
+
+    barrier();
+    data = &_data[i];
+    return n < size - i ? n : size - i;
+  }
+
+  void consume(index_t n) { publish(_tail, _tail + n); }
+
+private:
+  // Either side may ask how full the buffer is
+  index_t count() const { return (index_t)(load(_head) - load(_tail)); }
+
+  // Each index is only written by its own side, so that side can read it
+  // as it likes; only the other side's one needs care
+  static index_t load(const volatile index_t &index)
+  {
+    if (sizeof(index_t) == 1)
+      return index;
+
+    uint8_t oldSREG = SREG;
+    cli();
+    index_t value = index;
+    SREG = oldSREG;
+    return value;
+  }
+
+  // _data isn't volatile, so keep the compiler from moving accesses to it
+  // across the index that says whether they are safe
+  static inline void barrier() { __asm__ __volatile__ ("" ::: "memory"); }
+
+  // Store the data before the index that makes it visible
+  static void publish(volatile index_t &index, index_t value)
+  {
+    barrier();
+    if (sizeof(index_t) == 1) {
+      index = value;
+      return;
+    }
+
+    uint8_t oldSREG = SREG;
+    cli();
+    index = value;
+    SREG = oldSREG;
+  }
+
+  volatile index_t _head;
+  volatile index_t _tail;
+  T _data[size];
+};
+
+#endif
@@ -0,0 +1,104 @@
+/*
+  Task.cpp - stackless cooperative tasks
+  Part of ButterflyCore
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "Arduino.h"
+#include "Task.h"
+
+TaskScheduler Tasks;
+
+// Called from yield() once a sketch uses tasks
+extern "C" void yieldTasks(void)
+{
+  Tasks.run();
+}
+
+void TaskScheduler::start(Task &task, TaskFunction function)
+{
+  if (!running(task)) {
+    task.next = _first;
+    _first = &task;
+  }
+  task.function = function;
+  task.line = 0;
+  task.sleeping = false;
+  // TASK_SLEEP_PERIOD() counts from here
+  task.wake = millis();
+}
+
+void TaskScheduler::stop(Task &task)
+{
+  Task **link;
+
+  for (link = &_first; *link; link = &(*link)->next) {
+    if (*link == &task) {
+      *link = task.next;
+      return;
+    }
+  }
+}
+
+bool TaskScheduler::running(Task &task)
+{
+  Task *t;
+
+  for (t = _first; t; t = t->next)
+    if (t == &task)
+      return true;
+  return false;
+}
+
+void TaskScheduler::run()
+{
+  Task *task, *next;
+
+  if (_running)
+    return;
+  _running = true;
+
+  for (task = _first; task; task = next) {
+    // The task may stop itself, or start others in front of it
+    next = task->next;
+    if (task->sleeping) {
+      if ((long)(millis() - task->wake) < 0)
+        continue;
+      task->sleeping = false;
+    }
+    if (task->function(task) == TASK_ENDED)
+      stop(*task);
+  }
+
+  _running = false;
+}
+
+unsigned long TaskScheduler::nextDeadline()
+{
+  unsigned long now = millis(), next = TASK_NO_DEADLINE;
+  Task *task;
+
+  for (task = _first; task; task = task->next) {
+    if (!task->sleeping)
+      return 0;
+    if ((long)(task->wake - now) <= 0)
+      return 0;
+    if (task->wake - now < next)
+      next = task->wake - now;
+  }
+  return next;
+}
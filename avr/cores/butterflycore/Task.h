@@ -0,0 +1,130 @@
+/*
+  Task.h - stackless cooperative tasks
+  Part of ButterflyCore
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+/*
+ * Protothread style tasks: each one is a function that returns whenever
+ * it has to wait, and carries on from the same line the next time it is
+ * called. They share the one stack, so a task costs a few bytes of RAM
+ * rather than a stack of its own.
+ *
+ *   Task blinker;
+ *
+ *   TASK(blink)
+ *   {
+ *     TASK_BEGIN();
+ *     for (;;) {
+ *       digitalWrite(LED_BUILTIN, !digitalRead(LED_BUILTIN));
+ *       TASK_SLEEP(500);
+ *     }
+ *     TASK_END();
+ *   }
+ *
+ *   Tasks.start(blinker, blink);
+ *
+ * The scheduler runs from yield(), which delay() and the core's other
+ * waiting loops call, and after every loop(). Tasks are run round-robin;
+ * sleeping ones only once their deadline has passed.
+ *
+ * Local variables don't survive a wait, so keep state in static or global
+ * variables. A switch statement can't span a wait either. A task that
+ * calls delay() itself still blocks every other task.
+ */
+
+#ifndef Task_h
+#define Task_h
+
+#include <inttypes.h>
+
+#define TASK_WAITING 0
+#define TASK_ENDED   1
+
+// nextDeadline() when no task is waiting for anything
+#define TASK_NO_DEADLINE 0xFFFFFFFFUL
+
+struct Task;
+typedef uint8_t (*TaskFunction)(Task *task);
+
+struct Task {
+  TaskFunction function;
+  unsigned int line;    // where to carry on from, 0 for the start
+  unsigned long wake;   // millis() to sleep until
+  bool sleeping;
+  Task *next;
+};
+
+#define TASK(name) uint8_t name(Task *task)
+
+#define TASK_BEGIN() switch (task->line) { case 0:
+
+#define TASK_END() } task->line = 0; return TASK_ENDED
+
+// Let the other tasks run, then carry on
+#define TASK_YIELD() \
+  do { task->line = __LINE__; return TASK_WAITING; case __LINE__:; } while (0)
+
+// Wait until condition is true, trying again each time round
+#define TASK_WAIT_UNTIL(condition) \
+  do { task->line = __LINE__; case __LINE__: \
+    if (!(condition)) return TASK_WAITING; } while (0)
+
+#define TASK_WAIT_WHILE(condition) TASK_WAIT_UNTIL(!(condition))
+
+// Sleep for ms milliseconds, taking no time from the other tasks
+#define TASK_SLEEP(ms) \
+  do { task->wake = millis() + (ms); task->sleeping = true; \
+    task->line = __LINE__; return TASK_WAITING; case __LINE__:; } while (0)
+
+// Sleep until ms after the last wake-up, for a steady period
+#define TASK_SLEEP_PERIOD(ms) \
+  do { task->wake += (ms); task->sleeping = true; \
+    task->line = __LINE__; return TASK_WAITING; case __LINE__:; } while (0)
+
+#define TASK_EXIT() do { task->line = 0; return TASK_ENDED; } while (0)
+
+#define TASK_RESTART() do { task->line = 0; return TASK_WAITING; } while (0)
+
+class TaskScheduler
+{
+public:
+  TaskScheduler() : _first(0), _running(false) {};
+
+  // Add a task, which first runs the next time round. Starting a task
+  // that runs already starts it over
+  void start(Task &task, TaskFunction function);
+  void stop(Task &task);
+  bool running(Task &task);
+
+  // Run each task that isn't asleep once. Does nothing if called from
+  // inside a task
+  void run();
+
+  // Milliseconds until a sleeping task is due, 0 if a task is waiting on
+  // a condition or due already, or TASK_NO_DEADLINE if there are none.
+  // Made for idle(): Tasks.run(); idle(Tasks.nextDeadline());
+  unsigned long nextDeadline();
+
+private:
+  Task *_first;
+  bool _running;
+};
+
+extern TaskScheduler Tasks;
+
+#endif
@@ -0,0 +1,172 @@
+/*
+  Thread.cpp - lightweight threads with their own stacks
+  Part of ButterflyCore
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include <string.h>
+#include "Arduino.h"
+#include "Thread.h"
+
+// ThreadSwitch.S
+extern "C" void thread_switch(uint8_t **save, uint8_t *sp);
+
+ThreadScheduler Threads;
+
+// The threads form a ring with the one loop() runs in, which has no stack
+// of its own to check
+static Thread main_thread = { 0, 0, 0, 0, THREAD_RUNNING, &main_thread };
+static Thread *current = &main_thread;
+
+// Called from yield() once a sketch uses threads
+extern "C" void yieldThreads(void)
+{
+  Threads.yield();
+}
+
+static bool guardIntact(Thread *thread)
+{
+  uint8_t i;
+
+  for (i = 0; i < THREAD_GUARD; i++)
+    if (thread->stack[i] != THREAD_CANARY)
+      return false;
+  return true;
+}
+
+static void unlink(Thread *thread)
+{
+  Thread *t = &main_thread;
+
+  while (t->next != thread) {
+    t = t->next;
+    if (t == &main_thread)
+      return;
+  }
+  t->next = thread->next;
+}
+
+// Switch from the current thread to the next one. Interrupts must be off.
+// A thread that has been taken out of the ring still points at the next
+// one, so it can switch away for the last time
+void threadSwitchNext(void)
+{
+  Thread *from = current, *to = from->next;
+
+  if (from->stack && !guardIntact(from)) {
+    from->state = THREAD_OVERFLOWED;
+    unlink(from);
+  }
+  if (to != from) {
+    current = to;
+    thread_switch(&from->sp, to->sp);
+  }
+}
+
+// Where a new thread starts, as if returning from thread_switch()
+static void threadEntry(void)
+{
+  sei();
+  current->function();
+  Threads.stop(*current);
+}
+
+bool ThreadScheduler::start(Thread &thread, ThreadFunction function, uint8_t *stack, unsigned int size)
+{
+  uint8_t oldSREG, *sp;
+  uint16_t entry = (uint16_t)threadEntry;
+
+  if (size < THREAD_STACK_MIN || running(thread))
+    return false;
+
+  memset(stack, THREAD_CANARY, size);
+  thread.stack = stack;
+  thread.size = size;
+  thread.function = function;
+
+  // The return address, high byte lowest as a call leaves it, then room
+  // for the registers thread_switch() pops
+  sp = stack + size - 1;
+  *sp-- = entry & 0xff;
+  *sp-- = entry >> 8;
+#if defined(__AVR_3_BYTE_PC__)
+  *sp-- = 0;
+#endif
+  thread.sp = sp - 18;
+
+  oldSREG = SREG;
+  cli();
+  thread.state = THREAD_RUNNING;
+  thread.next = main_thread.next;
+  main_thread.next = &thread;
+  SREG = oldSREG;
+  return true;
+}
+
+// A thread may stop itself, and loop() can't be stopped
+void ThreadScheduler::stop(Thread &thread)
+{
+  uint8_t oldSREG = SREG;
+
+  if (&thread == &main_thread)
+    return;
+
+  cli();
+  unlink(&thread);
+  if (thread.state == THREAD_RUNNING)
+    thread.state = THREAD_STOPPED;
+  if (&thread == current)
+    threadSwitchNext();
+  SREG = oldSREG;
+}
+
+bool ThreadScheduler::running(Thread &thread)
+{
+  Thread *t = &main_thread;
+
+  do {
+    if (t == &thread)
+      return true;
+    t = t->next;
+  } while (t != &main_thread);
+  return false;
+}
+
+void ThreadScheduler::yield()
+{
+  uint8_t oldSREG = SREG;
+
+  cli();
+  threadSwitchNext();
+  SREG = oldSREG;
+}
+
+unsigned int ThreadScheduler::stackUsed(Thread &thread)
+{
+  unsigned int i;
+
+  if (!thread.stack)
+    return 0;
+  for (i = 0; i < thread.size && thread.stack[i] == THREAD_CANARY; i++)
+    ;
+  return thread.size - i;
+}
+
+bool ThreadScheduler::overflowed(Thread &thread)
+{
+  return thread.state == THREAD_OVERFLOWED || (thread.stack && !guardIntact(&thread));
+}
@@ -0,0 +1,107 @@
+/*
+  Thread.h - lightweight threads with their own stacks
+  Part of ButterflyCore
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+/*
+ * Threads for code that can't be turned into tasks (see Task.h), such as
+ * a driver that calls delay(). Each thread has a stack of its own, given
+ * to it by the sketch, and loop() keeps running on the main stack:
+ *
+ *   Thread sensor;
+ *   uint8_t sensorStack[128];
+ *
+ *   void readSensor()
+ *   {
+ *     for (;;) {
+ *       ...
+ *       delay(1000);
+ *     }
+ *   }
+ *
+ *   Threads.start(sensor, readSensor, sensorStack);
+ *
+ * Threads take turns whenever the running one calls yield(), which
+ * delay() and the core's other waiting loops do. Threads.preempt() also
+ * switches threads from the Timer0 compare interrupt.
+ *
+ * A thread ends when its function returns. Switching saves 18 registers
+ * and the return address on the thread's stack, and an interrupt needs
+ * about as much again on top of what the thread uses itself. Keep
+ * stacks at THREAD_STACK_MIN bytes or more, and check them with
+ * stackUsed(). A thread that runs past the bottom of its stack is
+ * stopped when it next switches out, and overflowed() tells so.
+ *
+ * malloc() compares the heap with the stack pointer, so String and new
+ * don't work from a thread unless __malloc_heap_end is set.
+ */
+
+#ifndef Thread_h
+#define Thread_h
+
+#include <inttypes.h>
+
+#define THREAD_STOPPED    0
+#define THREAD_RUNNING    1
+#define THREAD_OVERFLOWED 2
+
+#define THREAD_STACK_MIN 64
+
+// Unused stack bytes are filled with this, and the lowest ones are
+// checked at every switch
+#define THREAD_CANARY 0xA5
+#define THREAD_GUARD  2
+
+typedef void (*ThreadFunction)(void);
+
+struct Thread {
+  uint8_t *sp;          // stack pointer while the thread is switched out
+  uint8_t *stack;       // lowest address of the stack
+  unsigned int size;
+  ThreadFunction function;
+  uint8_t state;
+  Thread *next;
+};
+
+class ThreadScheduler
+{
+public:
+  // Start function on stack, to run the next time the current thread
+  // yields. Returns false if the stack is too small or the thread runs
+  // already
+  bool start(Thread &thread, ThreadFunction function, uint8_t *stack, unsigned int size);
+  template <unsigned int size> bool start(Thread &thread, ThreadFunction function, uint8_t (&stack)[size])
+    { return start(thread, function, stack, size); }
+  void stop(Thread &thread);
+  bool running(Thread &thread);
+
+  // Switch to the next thread that runs, and back once the others yield
+  void yield();
+
+  // Also switch every slice Timer0 overflows (every 2.048 ms at 8 MHz),
+  // or only on yield() if slice is 0
+  void preempt(uint8_t slice);
+
+  // Most stack bytes the thread has used so far
+  unsigned int stackUsed(Thread &thread);
+  bool overflowed(Thread &thread);
+};
+
+extern ThreadScheduler Threads;
+
+#endif
@@ -0,0 +1,66 @@
+/*
+  ThreadPreempt.cpp - time slices for threads
+  Part of ButterflyCore
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "Arduino.h"
+#include "Thread.h"
+
+/*
+ * Kept apart from Thread.cpp so that only sketches calling preempt() take
+ * the Timer0 compare interrupt. It fires once every Timer0 period whatever
+ * OCR0A holds, so PWM on OC0A keeps working. The slice stretches along
+ * with setClockDivider().
+ *
+ * A preempted thread may be halfway through anything, so threads sharing
+ * Serial, SPI, the LCD or any other state have to take turns with
+ * interrupts off or their own flags.
+ */
+
+void threadSwitchNext(void);
+
+static uint8_t slice_ticks, slice_left;
+
+void ThreadScheduler::preempt(uint8_t slice)
+{
+  uint8_t oldSREG = SREG;
+
+  cli();
+  slice_ticks = slice_left = slice;
+  if (slice) {
+    TIFR0 = _BV(OCF0A);
+    TIMSK0 |= _BV(OCIE0A);
+  } else {
+    TIMSK0 &= ~_BV(OCIE0A);
+  }
+  SREG = oldSREG;
+}
+
+// The interrupted thread keeps the interrupt frame on its stack, and
+// returns from it when its turn comes again
+#if defined(TIMER0_COMP_vect)
+ISR(TIMER0_COMP_vect)
+#else
+ISR(TIMER0_COMPA_vect)
+#endif
+{
+  if (--slice_left)
+    return;
+  slice_left = slice_ticks;
+  threadSwitchNext();
+}
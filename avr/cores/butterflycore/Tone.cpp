@@ -125,6 +125,29 @@ static uint8_t tone_pins[AVAILABLE_TONE_PINS] = { 255 /*, 255, 255 */ };
 
 
 
+// Weakly referenced, so tone() doesn't pull in the clock scaling code
+extern "C" uint8_t attachClockChange(void (*callback)(void)) __attribute__((weak));
+
+static unsigned int tone_frequency;
+
+#ifdef USE_TIMER1
+// Called after setClockDivider(): keep a playing tone at its pitch
+static void toneClockChanged(void)
+{
+  if (tone_pins[0] != 255 && bitRead(TIMSK1, OCIE1A))
+  {
+    uint8_t oldSREG = SREG;
+    cli();
+    long toggle_count = timer1_toggle_count;
+    tone(tone_pins[0], tone_frequency);
+    timer1_toggle_count = toggle_count;
+    // a count already past the new OCR1A would run on to 0xffff
+    TCNT1 = 0;
+    SREG = oldSREG;
+  }
+}
+#endif
+
 static int8_t toneBegin(uint8_t _pin)
 {
   int8_t _timer = -1;
@@ -246,49 +269,56 @@ void tone(uint8_t _pin, unsigned int frequency, unsigned long duration)
   long toggle_count = 0;
   uint32_t ocr = 0;
   int8_t _timer;
+  unsigned long clock = cpuFrequency();
 
   _timer = toneBegin(_pin);
 
   if (_timer >= 0)
   {
+    tone_frequency = frequency;
+#ifdef USE_TIMER1
+    if (attachClockChange)
+      attachClockChange(toneClockChanged);
+#endif
+
     // Set the pinMode as OUTPUT
     pinMode(_pin, OUTPUT);
     
     // if we are using an 8 bit timer, scan through prescalars to find the best fit
     if (_timer == 0 || _timer == 2)
     {
-      ocr = F_CPU / frequency / 2 - 1;
+      ocr = clock / frequency / 2 - 1;
       prescalarbits = 0b001;  // ck/1: same for both timers
       if (ocr > 255)
       {
-        ocr = F_CPU / frequency / 2 / 8 - 1;
+        ocr = clock / frequency / 2 / 8 - 1;
         prescalarbits = 0b010;  // ck/8: same for both timers
 
         if (_timer == 2 && ocr > 255)
         {
-          ocr = F_CPU / frequency / 2 / 32 - 1;
+          ocr = clock / frequency / 2 / 32 - 1;
           prescalarbits = 0b011;
         }
 
         if (ocr > 255)
         {
-          ocr = F_CPU / frequency / 2 / 64 - 1;
+          ocr = clock / frequency / 2 / 64 - 1;
           prescalarbits = _timer == 0 ? 0b011 : 0b100;
 
           if (_timer == 2 && ocr > 255)
           {
-            ocr = F_CPU / frequency / 2 / 128 - 1;
+            ocr = clock / frequency / 2 / 128 - 1;
             prescalarbits = 0b101;
           }
 
           if (ocr > 255)
           {
-            ocr = F_CPU / frequency / 2 / 256 - 1;
+            ocr = clock / frequency / 2 / 256 - 1;
             prescalarbits = _timer == 0 ? 0b100 : 0b110;
             if (ocr > 255)
             {
               // can't do any better than /1024
-              ocr = F_CPU / frequency / 2 / 1024 - 1;
+              ocr = clock / frequency / 2 / 1024 - 1;
               prescalarbits = _timer == 0 ? 0b101 : 0b111;
             }
           }
@@ -315,12 +345,12 @@ void tone(uint8_t _pin, unsigned int frequency, unsigned long duration)
     else
     {
       // two choices for the 16 bit timers: ck/1 or ck/64
-      ocr = F_CPU / frequency / 2 - 1;
+      ocr = clock / frequency / 2 - 1;
 
       prescalarbits = 0b001;
       if (ocr > 0xffff)
       {
-        ocr = F_CPU / frequency / 2 / 64 - 1;
+        ocr = clock / frequency / 2 / 64 - 1;
         prescalarbits = 0b011;
       }
 
@@ -17,15 +17,22 @@
 */
 
 /**
- * Empty yield() hook.
+ * yield() hook.
  *
  * This function is intended to be used by library writers to build
  * libraries or sketches that supports cooperative threads.
  *
+ * It runs the core's tasks (Task.h) and threads (Thread.h), each only
+ * when the sketch uses them, and does nothing otherwise.
+ *
  * Its defined as a weak symbol and it can be redefined to implement a
  * real cooperative scheduler.
  */
-static void __empty() {
-	// Empty
+void yieldTasks(void) __attribute__ ((weak));
+void yieldThreads(void) __attribute__ ((weak));
+
+void yield(void) __attribute__ ((weak));
+void yield(void) {
+	if (yieldTasks) yieldTasks();
+	if (yieldThreads) yieldThreads();
 }
-void yield(void) __attribute__ ((weak, alias("__empty")));
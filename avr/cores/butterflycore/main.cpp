@@ -44,6 +44,7 @@ int main(void)
     
 	for (;;) {
 		loop();
+		yield();
 		if (serialEventRun) serialEventRun();
 	}
         
@@ -22,6 +22,47 @@
 
 #include "wiring_private.h"
 
+// log2 of the CPU clock divider; see setClockDivider()
+uint8_t clock_shift = 0;
+
+uint8_t getClockDivider(void)
+{
+	return clock_shift;
+}
+
+unsigned long cpuFrequency(void)
+{
+	return F_CPU >> clock_shift;
+}
+
+#ifdef MILLIS_RTC
+
+// millis() and micros() are kept by the RTC on the Timer2 watch crystal
+// (see wiring_rtc.c) instead of Timer0, so they go on counting in
+// power-save sleep. Timer2 ticks 1024 times a second, which is as fine as
+// micros() gets.
+#if !defined(ASSR) || !defined(AS2)
+#error MILLIS_RTC needs an asynchronous Timer2
+#endif
+
+unsigned long millis()
+{
+	uint8_t t;
+	unsigned long n = timer2_read(&t);
+
+	// 250 ms per overflow, 125/128 ms per tick
+	return n * 250 + (((unsigned int)t * 125) >> 7);
+}
+
+unsigned long micros() {
+	uint8_t t;
+	unsigned long n = timer2_read(&t);
+
+	return n * 250000UL + (((unsigned long)t * 15625) >> 4);
+}
+
+#else
+
 // the prescaler is set so that timer0 ticks every 64 clock cycles, and the
 // the overflow handler is called every 256 ticks.
 #define MICROSECONDS_PER_TIMER0_OVERFLOW (clockCyclesToMicroseconds(64 * 256))
@@ -35,9 +76,15 @@
 #define FRACT_INC ((MICROSECONDS_PER_TIMER0_OVERFLOW % 1000) >> 3)
 #define FRACT_MAX (1000 >> 3)
 
+// timer0_overflow_count counts overflows at the full clock speed. With
+// the clock divided each overflow takes longer, so the overflow handler
+// adds these instead of the constants above
 volatile unsigned long timer0_overflow_count = 0;
 volatile unsigned long timer0_millis = 0;
 static unsigned char timer0_fract = 0;
+static unsigned int timer0_millis_inc = MILLIS_INC;
+static unsigned char timer0_fract_inc = FRACT_INC;
+static unsigned int timer0_count_inc = 1;
 
 #if defined(__AVR_ATtiny24__) || defined(__AVR_ATtiny44__) || defined(__AVR_ATtiny84__)
 ISR(TIM0_OVF_vect)
@@ -50,8 +97,8 @@ ISR(TIMER0_OVF_vect)
 	unsigned long m = timer0_millis;
 	unsigned char f = timer0_fract;
 
-	m += MILLIS_INC;
-	f += FRACT_INC;
+	m += timer0_millis_inc;
+	f += timer0_fract_inc;
 	if (f >= FRACT_MAX) {
 		f -= FRACT_MAX;
 		m += 1;
@@ -59,50 +106,111 @@ ISR(TIMER0_OVF_vect)
 
 	timer0_fract = f;
 	timer0_millis = m;
-	timer0_overflow_count++;
+	timer0_overflow_count += timer0_count_inc;
 }
 
 unsigned long millis()
 {
 	unsigned long m;
-	uint8_t oldSREG = SREG;
 
-	// disable interrupts while we read timer0_millis or we might get an
-	// inconsistent value (e.g. in the middle of a write to timer0_millis)
-	cli();
-	m = timer0_millis;
-	SREG = oldSREG;
+	// the overflow handler may change timer0_millis halfway through the
+	// read. rather than holding interrupts off, read it until two reads
+	// agree; the handler runs at most once in that time
+	do {
+		m = timer0_millis;
+	} while (m != timer0_millis);
 
 	return m;
 }
 
 unsigned long micros() {
 	unsigned long m;
-	uint8_t oldSREG = SREG, t;
-	
-	cli();
-	m = timer0_overflow_count;
+	uint8_t t, overflow;
+
+	// the same goes for the overflow count, which has to match TCNT0 and
+	// the overflow flag as well
+	do {
+		m = timer0_overflow_count;
 #if defined(TCNT0)
-	t = TCNT0;
+		t = TCNT0;
 #elif defined(TCNT0L)
-	t = TCNT0L;
+		t = TCNT0L;
 #else
-	#error TIMER 0 not defined
+		#error TIMER 0 not defined
 #endif
-
 #ifdef TIFR0
-	if ((TIFR0 & _BV(TOV0)) && (t < 255))
-		m++;
+		overflow = TIFR0 & _BV(TOV0);
 #else
-	if ((TIFR & _BV(TOV0)) && (t < 255))
-		m++;
+		overflow = TIFR & _BV(TOV0);
 #endif
+	} while (m != timer0_overflow_count);
+
+	// an overflow the handler hasn't seen yet, with interrupts off
+	if (overflow && (t < 255))
+		m += timer0_count_inc;
+
+	return ((m << 8) + ((unsigned long)t << clock_shift)) * (64 / clockCyclesPerMicrosecond());
+}
 
+// Add n overflows at the full clock speed. Interrupts must be off
+static void timer0_add(unsigned long n)
+{
+	unsigned int f = timer0_fract + (unsigned int)n * FRACT_INC;
+
+	timer0_millis += n * MILLIS_INC + f / FRACT_MAX;
+	timer0_fract = f % FRACT_MAX;
+	timer0_overflow_count += n;
+}
+
+// Account for time spent asleep with Timer0 stopped, as if its overflow
+// interrupt had gone on running. Used by idle()
+void timer0_advance(unsigned long us)
+{
+	static unsigned int rest; // microseconds short of a whole overflow
+	unsigned long n;
+	uint8_t oldSREG;
+
+	us += rest;
+	n = us / MICROSECONDS_PER_TIMER0_OVERFLOW;
+	rest = us % MICROSECONDS_PER_TIMER0_OVERFLOW;
+
+	oldSREG = SREG;
+	cli();
+	timer0_add(n);
 	SREG = oldSREG;
-	
-	return ((m << 8) + t) * (64 / clockCyclesPerMicrosecond());
 }
 
+// Switch the overflow handler to a new clock divider. Called by
+// setClockDivider() with interrupts off, just before the clock changes.
+// The part of an overflow that has gone by at the old speed is carried
+// over into TCNT0 at the new one
+void timer0_rescale(uint8_t shift)
+{
+	static uint8_t carry; // full speed ticks short of a whole tick
+	unsigned int ticks;
+	unsigned long us;
+
+	// An overflow still waiting for its interrupt belongs to the old speed
+	if (TIFR0 & _BV(TOV0)) {
+		TIFR0 = _BV(TOV0);
+		timer0_add(timer0_count_inc);
+	}
+
+	// Ticks at the full speed into this overflow, at most 255 << 8 + 255
+	ticks = ((unsigned int)TCNT0 << clock_shift) + carry;
+	timer0_add(ticks >> 8 >> shift << shift);
+	ticks &= (256U << shift) - 1;
+	TCNT0 = ticks >> shift;
+	carry = ticks & ((1 << shift) - 1);
+
+	us = (unsigned long)MICROSECONDS_PER_TIMER0_OVERFLOW << shift;
+	timer0_millis_inc = us / 1000;
+	timer0_fract_inc = (us % 1000) >> 3;
+	timer0_count_inc = 1 << shift;
+}
+
+#endif
+
 void delay(unsigned long ms)
 {
 	uint32_t start = micros();
@@ -124,6 +232,10 @@ void delayMicroseconds(unsigned int us)
 	// calling avrlib's delay_us() function with low values (e.g. 1 or
 	// 2 microseconds) gives delays longer than desired.
 	//delay_us(us);
+
+	// the loops below run slower with the clock divided
+	us >>= clock_shift;
+
 #if F_CPU >= 24000000L
 	// for the 24 MHz clock for the aventurous ones, trying to overclock
 
@@ -275,7 +387,9 @@ void init()
 #endif
 
 	// enable timer 0 overflow interrupt
-#if defined(TIMSK) && defined(TOIE0)
+#if defined(MILLIS_RTC)
+	// not needed; the RTC keeps time
+#elif defined(TIMSK) && defined(TOIE0)
 	sbi(TIMSK, TOIE0);
 #elif defined(TIMSK0) && defined(TOIE0)
 	sbi(TIMSK0, TOIE0);
@@ -391,4 +505,15 @@ void init()
 #elif defined(UCSR0B)
 	UCSR0B = 0;
 #endif
+
+#ifdef MILLIS_RTC
+	// this takes timer 2 over from pwm
+	rtcBegin();
+#endif
+
+#ifdef OSCCAL_CALIBRATE
+	// tune the internal oscillator to the watch crystal; this can take up
+	// to 1.5 seconds while the crystal starts
+	calibrateOscillator();
+#endif
 }
@@ -0,0 +1,105 @@
+/*
+  wiring_clock.c - CPU clock scaling at run time
+  Part of ButterflyCore
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+
+/*
+ * setClockDivider() divides the CPU clock by 1 to 256 through CLKPR, so a
+ * sketch can run slowly while it waits and at full speed when there's
+ * work. F_CPU stays the full speed; cpuFrequency() gives the current one.
+ *
+ * millis(), micros(), delay() and delayMicroseconds() keep their timing
+ * and the ADC prescaler is reset for the new speed. Anything else that
+ * depends on the clock registers a callback with attachClockChange(), to
+ * be called once the clock has changed. The core's serial ports and
+ * tone() do so, as does the Servo library.
+ *
+ * A byte that is being sent or received while the clock changes is lost,
+ * so call Serial.flush() first if that matters.
+ */
+
+#if defined(CLKPR)
+
+#ifndef CLOCK_CALLBACKS
+#define CLOCK_CALLBACKS 4
+#endif
+
+static voidFuncPtr clock_callbacks[CLOCK_CALLBACKS];
+
+// Returns 1 if callback is registered, 0 if there is no room for it
+uint8_t attachClockChange(void (*callback)(void))
+{
+	uint8_t i, free = CLOCK_CALLBACKS;
+
+	for (i = 0; i < CLOCK_CALLBACKS; i++) {
+		if (clock_callbacks[i] == callback)
+			return 1;
+		if (!clock_callbacks[i] && free == CLOCK_CALLBACKS)
+			free = i;
+	}
+	if (free == CLOCK_CALLBACKS)
+		return 0;
+	clock_callbacks[free] = callback;
+	return 1;
+}
+
+void detachClockChange(void (*callback)(void))
+{
+	uint8_t i;
+
+	for (i = 0; i < CLOCK_CALLBACKS; i++)
+		if (clock_callbacks[i] == callback)
+			clock_callbacks[i] = 0;
+}
+
+// divider is one of CLOCK_DIV1 to CLOCK_DIV256
+void setClockDivider(uint8_t divider)
+{
+	uint8_t oldSREG, i, adps;
+	unsigned long f;
+
+	if (divider > CLOCK_DIV256 || divider == clock_shift)
+		return;
+
+	oldSREG = SREG;
+	cli();
+#ifndef MILLIS_RTC
+	timer0_rescale(divider);
+#endif
+	// The new value has to follow the enable bit within four cycles
+	CLKPR = _BV(CLKPCE);
+	CLKPR = divider;
+	clock_shift = divider;
+	SREG = oldSREG;
+
+#if defined(ADCSRA)
+	// keep the ADC clock inside 50-200 kHz where the prescaler allows
+	f = F_CPU >> divider;
+	for (adps = 1; adps < 7 && (f >> adps) > 200000; adps++)
+		;
+	ADCSRA = (ADCSRA & ~(_BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0))) | adps;
+#endif
+
+	for (i = 0; i < CLOCK_CALLBACKS; i++)
+		if (clock_callbacks[i])
+			clock_callbacks[i]();
+}
+
+#endif
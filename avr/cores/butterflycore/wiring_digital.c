@@ -26,6 +26,12 @@
 #include "wiring_private.h"
 #include "pins_arduino.h"
 
+// Writing a one to a bit in PINx flips that bit in PORTx on every chip
+// this core supports except the first ATmega169
+#if !defined(__AVR_ATmega169__)
+#define PIN_TOGGLE
+#endif
+
 void pinMode(uint8_t pin, uint8_t mode)
 {
 	uint8_t bit = digitalPinToBitMask(pin);
@@ -38,16 +44,22 @@ void pinMode(uint8_t pin, uint8_t mode)
 	reg = portModeRegister(port);
 	out = portOutputRegister(port);
 
+	// each read-modify-write gets its own short critical section; the
+	// pin is an input before its pullup changes either way
 	if (mode == INPUT) { 
 		uint8_t oldSREG = SREG;
                 cli();
 		*reg &= ~bit;
+		SREG = oldSREG;
+		cli();
 		*out &= ~bit;
 		SREG = oldSREG;
 	} else if (mode == INPUT_PULLUP) {
 		uint8_t oldSREG = SREG;
                 cli();
 		*reg &= ~bit;
+		SREG = oldSREG;
+		cli();
 		*out |= bit;
 		SREG = oldSREG;
 	} else {
@@ -154,6 +166,13 @@ void digitalWrite(uint8_t pin, uint8_t val)
 
 	out = portOutputRegister(port);
 
+#ifdef PIN_TOGGLE
+	// flipping the bit through PINx leaves the rest of the port alone, so
+	// an interrupt changing another pin in between can't be undone. Only
+	// an interrupt writing this same pin at this moment could be
+	if (!(*out & bit) != (val == LOW))
+		*portInputRegister(port) = bit;
+#else
 	uint8_t oldSREG = SREG;
 	cli();
 
@@ -164,6 +183,7 @@ void digitalWrite(uint8_t pin, uint8_t val)
 	}
 
 	SREG = oldSREG;
+#endif
 }
 
 int digitalRead(uint8_t pin)
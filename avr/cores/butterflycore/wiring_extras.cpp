@@ -25,9 +25,8 @@ void _portMode(uint8_t port, uint8_t mode)
   if(moderegister == NULL) 
   	return;
 
-  uint8_t oldSREG = SREG;
-  cli();
-
+  // Whole registers are written, never read back and modified, so there's
+  // nothing an interrupt could get in the middle of here or below
   if(mode == OUTPUT)
     *moderegister = 0xff;
   else if(mode == INPUT_PULLUP)
@@ -38,8 +37,6 @@ void _portMode(uint8_t port, uint8_t mode)
   }  
   else // INPUT
     *moderegister = 0x00;
-
-  SREG = oldSREG;
 }
 
 
@@ -52,11 +49,7 @@ uint8_t _portRead(uint8_t port)
   if(inputregister == NULL) 
   	return 0;
 
-  uint8_t oldSREG = SREG;
-  cli();
-  uint8_t portValue = *inputregister;
-  SREG = oldSREG;
-  return portValue;
+  return *inputregister;
 }
 
 
@@ -69,8 +62,5 @@ void _portWrite(uint8_t port, uint8_t val)
   if(portregister == NULL) 
   	return;
 
-  uint8_t oldSREG = SREG;
-  cli();
   *portregister = val;
-  SREG = oldSREG;
 }
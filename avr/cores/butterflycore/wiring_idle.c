@@ -0,0 +1,163 @@
+/*
+  wiring_idle.c - low power waiting
+  Part of ButterflyCore
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include <avr/sleep.h>
+#include "wiring_private.h"
+
+#ifndef MILLIS_RTC
+extern volatile unsigned long timer0_overflow_count;
+#endif
+
+/*
+ * idle() waits like delay(), but with the CPU asleep. Once Timer2 runs from
+ * the 32.768 kHz watch crystal (see enableTimer2Crystal()) it uses
+ * power-save sleep: the main clock stops, Timer0 and millis() with it, and a
+ * Timer2 compare match wakes the CPU when the time is up. millis() and
+ * micros() are then moved on by the time spent asleep, unless they are
+ * kept by the RTC in the first place (MILLIS_RTC). Without the crystal the
+ * CPU only enters idle sleep, and Timer0 wakes it every overflow.
+ *
+ * idle() returns early if any other interrupt wakes the CPU, so a sketch
+ * can sleep until its next timer deadline and still react to a button
+ * straight away. In power-save sleep only a pin change, INT0, Timer2 and
+ * the USI start condition can wake it. The USART stops with the main
+ * clock, so a serial byte sent then is neither noticed nor received
+ * intact. Idle sleep wakes on any interrupt, serial included. The RTC's
+ * own overflow interrupt doesn't count, but an RTC alarm does.
+ */
+
+#if defined(ASSR) && defined(AS2)
+
+// Timer2 counts 1024 Hz ticks from the crystal
+#define TIMER2_TICK_US_X16 15625UL // 976.5625 us, times 16
+
+// Set by the RTC when its overflow interrupt was all that happened
+volatile uint8_t timer2_overflowed;
+
+EMPTY_INTERRUPT(TIMER2_COMP_vect);
+
+// The crystal takes about a second to settle after this is first called.
+// Once it runs this does nothing, so the RTC is left alone
+void enableTimer2Crystal(void)
+{
+	uint8_t oldSREG = SREG;
+
+	if (ASSR & _BV(AS2))
+		return;
+	cli();
+	// This takes Timer2 from analogWrite() on its PWM pin
+	TIMSK2 = 0;
+	ASSR |= _BV(AS2);
+	TCNT2 = 0;
+	TCCR2A = _BV(CS21) | _BV(CS20); // normal mode, TOSC/32
+	while (ASSR & (_BV(TCN2UB) | _BV(OCR2UB) | _BV(TCR2UB)))
+		;
+	TIFR2 = _BV(OCF2A) | _BV(TOV2);
+	SREG = oldSREG;
+}
+
+// Sleep in power-save until Timer2 is at most ms further on. Returns 0 if
+// something else woke the CPU first
+static uint8_t sleepTimer2(unsigned long ms)
+{
+	uint8_t ticks, start, elapsed;
+#ifndef MILLIS_RTC
+	unsigned long awake, us;
+#endif
+
+	// A compare match can be up to 255 ticks away; less than two could be
+	// missed as the counter moves on while OCR2A is updated
+	ticks = ms >= 249 ? 255 : (ms * 128 + 124) / 125;
+	if (ticks < 2)
+		ticks = 2;
+
+#ifndef MILLIS_RTC
+	// Time spent awake in here is counted by Timer0 as usual
+	awake = micros();
+#endif
+	start = TCNT2;
+	OCR2A = start + ticks;
+	while (ASSR & _BV(OCR2UB))
+		;
+	TIFR2 = _BV(OCF2A);
+	TIMSK2 |= _BV(OCIE2A);
+	timer2_overflowed = 0;
+
+	set_sleep_mode(SLEEP_MODE_PWR_SAVE);
+	cli();
+	sleep_enable();
+	sei();
+	sleep_cpu();
+	sleep_disable();
+	TIMSK2 &= ~_BV(OCIE2A);
+
+	// TCNT2 reads wrong until a TOSC cycle after waking up; waiting for a
+	// write to go through takes care of that
+	OCR2A = OCR2A;
+	while (ASSR & _BV(OCR2UB))
+		;
+	elapsed = TCNT2 - start;
+#ifndef MILLIS_RTC
+	awake = micros() - awake;
+
+	us = elapsed * TIMER2_TICK_US_X16 / 16;
+	if (us > awake)
+		timer0_advance(us - awake);
+#endif
+
+	return elapsed >= ticks || timer2_overflowed;
+}
+
+#endif
+
+void idle(unsigned long ms)
+{
+	unsigned long start = millis();
+	unsigned long slept;
+
+	while ((slept = millis() - start) < ms) {
+#if defined(ASSR) && defined(AS2)
+		if (ASSR & _BV(AS2)) {
+			if (!sleepTimer2(ms - slept))
+				return;
+			continue;
+		}
+#endif
+#ifndef MILLIS_RTC
+		// Only the CPU stops; the next Timer0 overflow wakes it. The count
+		// goes up by timer0_count_inc, which is 256 at CLOCK_DIV256, so the
+		// whole of it is compared
+		unsigned long count;
+		uint8_t overflowed;
+		set_sleep_mode(SLEEP_MODE_IDLE);
+		cli();
+		count = timer0_overflow_count;
+		sleep_enable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+		cli();
+		overflowed = timer0_overflow_count != count;
+		sei();
+		if (!overflowed)
+			return;
+#endif
+	}
+}
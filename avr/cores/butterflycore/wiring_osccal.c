@@ -0,0 +1,209 @@
+/*
+  wiring_osccal.c - internal RC oscillator calibration
+  Part of ButterflyCore
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+
+/*
+ * The internal RC oscillator is tuned against the 32.768 kHz watch
+ * crystal: Timer1 counts CPU cycles over a few Timer2 ticks, and OSCCAL is
+ * moved until the count matches F_CPU to within 0.5%.
+ *
+ * Timer1 is borrowed while this runs, so PWM on its pins, tone(), Servo
+ * and the Timer library's interrupt pause for a moment. The UART baud rate
+ * shifts with the clock, so don't calibrate halfway through a transfer.
+ */
+
+#if defined(ASSR) && defined(AS2) && defined(OSCCAL)
+
+// Timer2 ticks (1/1024 s each) to count CPU cycles over
+#if F_CPU > 8000000L
+#define CAL_TICKS 4
+#else
+#define CAL_TICKS 8
+#endif
+// CPU cycles that should go by in that time, at the current clock divider
+#define CAL_TARGET ((long)(F_CPU * CAL_TICKS / 1024) >> clock_shift)
+#define CAL_TOLERANCE (CAL_TARGET / 200)
+
+// Measurements to wait for the crystal to settle, about 1.5 seconds
+#define CAL_SETTLE (1536 / CAL_TICKS)
+
+static uint8_t tccr1a, tccr1b, timsk1;
+static uint16_t tcnt1;
+
+static void takeTimer1(void)
+{
+	tccr1a = TCCR1A;
+	tccr1b = TCCR1B;
+	timsk1 = TIMSK1;
+	tcnt1 = TCNT1;
+	TIMSK1 = 0;
+	TCCR1B = 0;
+	TCCR1A = 0;
+	TCCR1B = _BV(CS10);
+}
+
+static void releaseTimer1(void)
+{
+	TCCR1B = 0;
+	TCNT1 = tcnt1;
+	TIFR1 = _BV(ICF1) | _BV(OCF1B) | _BV(OCF1A) | _BV(TOV1);
+	TCCR1A = tccr1a;
+	TCCR1B = tccr1b;
+	TIMSK1 = timsk1;
+}
+
+// CPU cycles in CAL_TICKS Timer2 ticks, or 0 if the crystal isn't running
+static long measure(void)
+{
+	uint8_t t, now, n = CAL_TICKS, high = 0;
+	uint16_t low;
+
+	// Line up with the start of a tick. Timer1 overflows after more than a
+	// tick at any clock speed
+	TCNT1 = 0;
+	TIFR1 = _BV(TOV1);
+	t = TCNT2;
+	while (TCNT2 == t)
+		if (TIFR1 & _BV(TOV1))
+			return 0;
+
+	TCNT1 = 0;
+	TIFR1 = _BV(TOV1);
+	t = TCNT2;
+	while (n) {
+		now = TCNT2;
+		if (now != t) {
+			t = now;
+			n--;
+		}
+		if (TIFR1 & _BV(TOV1)) {
+			TIFR1 = _BV(TOV1);
+			if (++high > 4)
+				return 0;
+		}
+	}
+	low = TCNT1;
+	if ((TIFR1 & _BV(TOV1)) && low < 0x8000)
+		high++;
+
+	return ((long)high << 16) | low;
+}
+
+static long deviation(long cycles)
+{
+	return cycles > CAL_TARGET ? cycles - CAL_TARGET : CAL_TARGET - cycles;
+}
+
+// A change of more than 2% from one cycle to the next can upset the CPU,
+// so OSCCAL is moved in small steps
+static void setOsccal(uint8_t value)
+{
+	uint8_t cal;
+
+	while ((cal = OSCCAL) != value) {
+		if (value > cal)
+			OSCCAL = value - cal > 0x10 ? cal + 0x10 : value;
+		else
+			OSCCAL = cal - value > 0x10 ? cal - 0x10 : value;
+	}
+}
+
+// Search the whole range OSCCAL is in for the value closest to F_CPU. The
+// crystal is started if need be, and the first call after that waits up
+// to 1.5 seconds for it to settle. Returns 1 if the clock is now within
+// 0.5% of F_CPU, 0 if it isn't or the crystal doesn't run
+uint8_t calibrateOscillator(void)
+{
+	uint8_t range = OSCCAL & 0x80, cal = 0, bit, ok = 0;
+	unsigned int i;
+	long last = 0, cycles = 0, below, above;
+
+	enableTimer2Crystal();
+	takeTimer1();
+
+	// Two measurements in a row that agree mean the crystal runs steadily
+	for (i = 0; i < CAL_SETTLE; i++) {
+		cycles = measure();
+		if (cycles && abs(cycles - last) <= CAL_TOLERANCE)
+			break;
+		last = cycles;
+	}
+
+	if (i < CAL_SETTLE) {
+		// The frequency goes up with OSCCAL within each of its two ranges;
+		// this finds the highest value that isn't too fast
+		for (bit = 0x40; bit; bit >>= 1) {
+			setOsccal(range | cal | bit);
+			if (measure() <= CAL_TARGET)
+				cal |= bit;
+		}
+
+		setOsccal(range | cal);
+		below = measure();
+		if (cal < 0x7f) {
+			setOsccal(range | (cal + 1));
+			above = measure();
+			if (deviation(above) < deviation(below))
+				below = above;
+			else
+				setOsccal(range | cal);
+		}
+		ok = below && deviation(below) <= CAL_TOLERANCE;
+	}
+
+	releaseTimer1();
+	return ok;
+}
+
+// Move OSCCAL one step towards F_CPU, if that helps. This takes two short
+// measurements, so it can be called every now and then to follow
+// temperature drift. Returns 1 if the clock is within 0.5% of F_CPU
+uint8_t trimOscillator(void)
+{
+	uint8_t cal = OSCCAL, next = cal;
+	long cycles, trimmed;
+
+	if (!(ASSR & _BV(AS2)))
+		return calibrateOscillator();
+
+	takeTimer1();
+	cycles = measure();
+	if (cycles && deviation(cycles) > CAL_TOLERANCE) {
+		if (cycles < CAL_TARGET && (cal & 0x7f) != 0x7f)
+			next = cal + 1;
+		else if (cycles > CAL_TARGET && (cal & 0x7f))
+			next = cal - 1;
+
+		if (next != cal) {
+			OSCCAL = next;
+			trimmed = measure();
+			if (trimmed && deviation(trimmed) < deviation(cycles))
+				cycles = trimmed;
+			else
+				OSCCAL = cal;
+		}
+	}
+	releaseTimer1();
+
+	return cycles && deviation(cycles) <= CAL_TOLERANCE;
+}
+
+#endif
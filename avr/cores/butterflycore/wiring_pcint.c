@@ -0,0 +1,121 @@
+/*
+  wiring_pcint.c - pin change interrupts
+  Part of ButterflyCore
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+
+/*
+ * PCINT0-7 (port E) and PCINT8-15 (port B) share one interrupt per port,
+ * which fires on any change of any enabled pin. The handlers compare the
+ * port with how it was last time and call the callback of each pin that
+ * changed the way it was attached for, lowest pin first. A pin without a
+ * callback is skipped.
+ *
+ * A pin that changes twice before the handler reads the port looks as if
+ * it didn't change. SoftwareSerial has handlers for the same interrupts,
+ * so it can't be used together with attachPinChangeInterrupt().
+ */
+
+#if defined(PCMSK0) && defined(PCMSK1) && defined(PCINT0_vect) && defined(PCINT1_vect)
+
+#define PCINT_PORTS 2
+
+static volatile voidFuncPtr pcint_func[PCINT_PORTS * 8];
+static volatile uint8_t pcint_rising[PCINT_PORTS];
+static volatile uint8_t pcint_falling[PCINT_PORTS];
+static uint8_t pcint_last[PCINT_PORTS];
+
+// mode is CHANGE, RISING or FALLING. A pin change can't tell a low level,
+// so LOW is taken as FALLING
+void attachPinChangeInterrupt(uint8_t pin, void (*userFunc)(void), int mode)
+{
+	volatile uint8_t *pcmsk = digitalPinToPCMSK(pin);
+	uint8_t port, bit, oldSREG;
+
+	if (!pcmsk)
+		return;
+	port = pcmsk == &PCMSK0 ? 0 : 1;
+	bit = _BV(digitalPinToPCMSKbit(pin));
+
+	oldSREG = SREG;
+	cli();
+	pcint_func[port * 8 + digitalPinToPCMSKbit(pin)] = userFunc;
+	if (mode == CHANGE || mode == RISING)
+		pcint_rising[port] |= bit;
+	else
+		pcint_rising[port] &= ~bit;
+	if (mode != RISING)
+		pcint_falling[port] |= bit;
+	else
+		pcint_falling[port] &= ~bit;
+
+	// Only this pin's last state is taken, so changes of the others that
+	// are waiting to be handled aren't lost
+	pcint_last[port] = (pcint_last[port] & ~bit) | ((port ? PINB : PINE) & bit);
+	*pcmsk |= bit;
+	*digitalPinToPCICR(pin) |= _BV(digitalPinToPCICRbit(pin));
+	SREG = oldSREG;
+}
+
+void detachPinChangeInterrupt(uint8_t pin)
+{
+	volatile uint8_t *pcmsk = digitalPinToPCMSK(pin);
+	uint8_t port, bit, oldSREG;
+
+	if (!pcmsk)
+		return;
+	port = pcmsk == &PCMSK0 ? 0 : 1;
+	bit = _BV(digitalPinToPCMSKbit(pin));
+
+	oldSREG = SREG;
+	cli();
+	*pcmsk &= ~bit;
+	if (!*pcmsk)
+		*digitalPinToPCICR(pin) &= ~_BV(digitalPinToPCICRbit(pin));
+	pcint_rising[port] &= ~bit;
+	pcint_falling[port] &= ~bit;
+	pcint_func[port * 8 + digitalPinToPCMSKbit(pin)] = 0;
+	SREG = oldSREG;
+}
+
+static inline void pcint_dispatch(uint8_t port, uint8_t now)
+{
+	uint8_t rising = pcint_rising[port], falling = pcint_falling[port];
+	uint8_t changed = (now ^ pcint_last[port]) & (rising | falling);
+	uint8_t fire = changed & ((now & rising) | (~now & falling));
+	volatile voidFuncPtr *func = &pcint_func[port * 8];
+
+	pcint_last[port] = now;
+	for (; fire; fire >>= 1, func++)
+		if ((fire & 1) && *func)
+			(*func)();
+}
+
+// The port is read first, as close to the change as can be
+ISR(PCINT0_vect)
+{
+	pcint_dispatch(0, PINE);
+}
+
+ISR(PCINT1_vect)
+{
+	pcint_dispatch(1, PINB);
+}
+
+#endif
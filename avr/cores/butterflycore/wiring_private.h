@@ -41,6 +41,12 @@ extern "C"{
 #define sbi(sfr, bit) (_SFR_BYTE(sfr) |= _BV(bit))
 #endif
 
+extern uint8_t clock_shift;
+void timer0_advance(unsigned long us);
+void timer0_rescale(uint8_t shift);
+unsigned long timer2_read(uint8_t *ticks);
+extern volatile uint8_t timer2_overflowed;
+
 uint32_t countPulseASM(volatile uint8_t *port, uint8_t bit, uint8_t stateMask, unsigned long maxloops);
 
 #define EXTERNAL_INT_0 0
@@ -0,0 +1,154 @@
+/*
+  wiring_rtc.c - real-time clock on the Timer2 watch crystal
+  Part of ButterflyCore
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+
+/*
+ * Timer2 counts 1024 Hz ticks from the 32.768 kHz crystal (see
+ * enableTimer2Crystal()) and overflows four times a second. The overflow
+ * interrupt counts those quarter seconds, and the time in seconds and the
+ * 1/1024 s sub-second counter are worked out from the count and TCNT2 when
+ * they are asked for. The crystal keeps running in power-save sleep, and
+ * the clock with it.
+ *
+ * Nothing here writes to Timer2, so the update busy flags only matter when
+ * the clock is started (enableTimer2Crystal() waits for them) and when
+ * TCNT2 is read straight after waking up (idle() takes care of that).
+ */
+
+#if defined(ASSR) && defined(AS2)
+
+volatile unsigned long timer2_overflow_count = 0;
+static unsigned long rtc_base; // seconds at overflow count 0
+static unsigned long rtc_alarm;
+static volatile uint8_t rtc_alarm_set;
+static volatile voidFuncPtr rtc_alarm_callback;
+
+ISR(TIMER2_OVF_vect)
+{
+	unsigned long n = timer2_overflow_count + 1;
+
+	timer2_overflow_count = n;
+
+	// Alarms go off on whole seconds. Anything else tells idle() that only
+	// the clock woke the CPU, so it can go back to sleep
+	if (rtc_alarm_set && !(n & 3) && (long)(rtc_base + (n >> 2) - rtc_alarm) >= 0) {
+		voidFuncPtr callback = rtc_alarm_callback;
+		rtc_alarm_set = 0;
+		if (callback)
+			callback();
+	} else {
+		timer2_overflowed = 1;
+	}
+}
+
+// The overflow count and TCNT2 together, the same way micros() reads
+// Timer0: without blocking interrupts, reading again if the overflow
+// interrupt ran in between
+unsigned long timer2_read(uint8_t *ticks)
+{
+	unsigned long n;
+	uint8_t t, overflow;
+
+	do {
+		n = timer2_overflow_count;
+		t = TCNT2;
+		overflow = TIFR2 & _BV(TOV2);
+	} while (n != timer2_overflow_count);
+
+	if (overflow && (t < 255))
+		n++;
+
+	*ticks = t;
+	return n;
+}
+
+// The crystal takes about a second to settle, and the clock stands still
+// until it does
+void rtcBegin(void)
+{
+	uint8_t oldSREG = SREG;
+
+	if (!(ASSR & _BV(AS2)))
+		enableTimer2Crystal();
+
+	cli();
+	TIFR2 = _BV(TOV2);
+	TIMSK2 |= _BV(TOIE2);
+	SREG = oldSREG;
+}
+
+// rtc_base only changes with interrupts off in rtcSetTime(), so unless
+// that is called from an interrupt this needn't block them either
+unsigned long rtcTime(void)
+{
+	uint8_t t;
+	unsigned long n = timer2_read(&t);
+
+	return rtc_base + (n >> 2);
+}
+
+// The sub-second counter isn't reset, so the first second after this may
+// be short
+void rtcSetTime(unsigned long seconds)
+{
+	unsigned long n;
+	uint8_t oldSREG = SREG, t;
+
+	cli();
+	n = timer2_read(&t);
+	rtc_base = seconds - (n >> 2);
+	SREG = oldSREG;
+}
+
+// 1/1024 s since the last whole second, 0 to 1023
+unsigned int rtcSubseconds(void)
+{
+	uint8_t t;
+	unsigned long n = timer2_read(&t);
+
+	return ((unsigned int)(n & 3) << 8) | t;
+}
+
+// Call callback from the Timer2 interrupt once rtcTime() reaches seconds.
+// The alarm also wakes the CPU from idle() for good; callback may be 0 if
+// that is all it is for
+void rtcSetAlarm(unsigned long seconds, void (*callback)(void))
+{
+	uint8_t oldSREG = SREG;
+
+	cli();
+	rtc_alarm = seconds;
+	rtc_alarm_callback = callback;
+	rtc_alarm_set = 1;
+	SREG = oldSREG;
+}
+
+void rtcClearAlarm(void)
+{
+	rtc_alarm_set = 0;
+}
+
+uint8_t rtcAlarmSet(void)
+{
+	return rtc_alarm_set;
+}
+
+#endif
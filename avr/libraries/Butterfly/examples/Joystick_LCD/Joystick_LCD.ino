@@ -0,0 +1,59 @@
+/*--------- ButterflyCore joystick example -------------|
+|                                                      |
+| https://github.com/MCUdude/ButterflyCore             |
+|                                                      |
+| Released to the public domain                        |
+|                                                      |
+| This example counts up and down with the joystick    |
+| and shows the count on the LCD. Holding the joystick |
+| up or down keeps counting, and pushing it in resets  |
+| the count. The CPU sleeps until the joystick moves.  |
+|-----------------------------------------------------*/
+
+#include "Butterfly.h"
+
+// Create an object of the ButterflyLCD class
+ButterflyLCD lcd;
+
+// Create an object of the ButterflyJoystick class
+ButterflyJoystick joystick;
+
+int count = 0;
+
+void setup()
+{
+  lcd.begin();
+  joystick.begin();
+  lcd.print(count);
+}
+
+
+void loop()
+{
+  while(joystick.available())
+  {
+    uint8_t event = joystick.read();
+
+    // Count on presses and on the repeats while the joystick is held
+    if(joystickEvent(event) == JOYSTICK_PRESS || joystickEvent(event) == JOYSTICK_REPEAT)
+    {
+      switch(joystickButton(event))
+      {
+        case JOYSTICK_UP:
+          count++;
+          break;
+        case JOYSTICK_DOWN:
+          count--;
+          break;
+        case JOYSTICK_PUSH:
+          count = 0;
+          break;
+      }
+      lcd.clear();
+      lcd.print(count);
+    }
+  }
+
+  // Sleep until the joystick moves, or it's time to debounce or repeat
+  idle(joystick.nextUpdate());
+}
@@ -0,0 +1,67 @@
+/*---------- ButterflyCore RTC clock example ----------|
+|                                                      |
+| https://github.com/MCUdude/ButterflyCore             |
+|                                                      |
+| Released to the public domain                        |
+|                                                      |
+| This example turns the Butterfly into a clock. Time  |
+| is kept by the 32.768 kHz watch crystal, and the     |
+| CPU sleeps in between updates of the LCD. An alarm   |
+| goes off every minute and flashes the colons.        |
+|-----------------------------------------------------*/
+
+#include "Butterfly.h"
+
+// Create an object of the ButterflyLCD class
+ButterflyLCD lcd;
+
+// Create an object of the ButterflyRTC class
+ButterflyRTC rtc;
+
+volatile bool alarmFired = false;
+
+// Called from an interrupt, so keep it short
+void alarm()
+{
+  alarmFired = true;
+}
+
+void setup()
+{
+  lcd.begin();
+
+  // Start the clock and set it to 12:00:00, 1 January 2017
+  rtc.begin();
+  rtc.setTime(2017, 1, 1, 12, 0, 0);
+  rtc.setAlarmIn(60, alarm);
+}
+
+
+void loop()
+{
+  ButterflyTime now;
+  char text[7];
+
+  rtc.getTime(now);
+  text[0] = '0' + now.hour / 10;
+  text[1] = '0' + now.hour % 10;
+  text[2] = '0' + now.minute / 10;
+  text[3] = '0' + now.minute % 10;
+  text[4] = '0' + now.second / 10;
+  text[5] = '0' + now.second % 10;
+  text[6] = '\0';
+  lcd.setCursor(0);
+  lcd.print(text);
+
+  if(alarmFired)
+  {
+    alarmFired = false;
+    lcd.showColons(true);
+    rtc.setAlarmIn(60, alarm);
+  }
+  else
+    lcd.showColons(false);
+
+  // Sleep until the next whole second
+  idle(1000 - (rtc.subseconds() * 1000UL >> 10));
+}
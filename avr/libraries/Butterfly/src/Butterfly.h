@@ -19,6 +19,8 @@
 #include "ButterflyLCD.h"
 #include "ButterflyTemp.h"
 #include "ButterflyDataflash.h"
+#include "ButterflyRTC.h"
+#include "ButterflyJoystick.h"
 
 
 #endif
\ No newline at end of file
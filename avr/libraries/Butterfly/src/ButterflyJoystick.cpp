@@ -0,0 +1,151 @@
+#include "ButterflyJoystick.h"
+#include "Arduino.h"
+
+
+// Pins of JOYSTICK_UP to JOYSTICK_PUSH: PB6, PB7, PE2, PE3 and PB4
+static const uint8_t joystickPins[5] = { 14, 15, 2, 3, 12 };
+
+// Set when a pin changes, until the next sample
+static volatile bool joystickChanged = false;
+
+static void joystickInterrupt()
+{
+  joystickChanged = true;
+}
+
+
+void ButterflyJoystick::begin()
+{
+  // A button held down already counts as pressed, without an event
+  _state = 0;
+  _held = JOYSTICK_NONE;
+  for(uint8_t i = 0; i < 5; i++)
+  {
+    pinMode(joystickPins[i], INPUT_PULLUP);
+    _count[i] = 0;
+  }
+  delayMicroseconds(10);
+  for(uint8_t i = 0; i < 5; i++)
+  {
+    if(!digitalRead(joystickPins[i]))
+    {
+      _count[i] = JOYSTICK_DEBOUNCE;
+      _state |= 1 << i;
+    }
+    attachPinChangeInterrupt(joystickPins[i], joystickInterrupt, CHANGE);
+  }
+  _lastSample = millis() - JOYSTICK_SAMPLE_MS;
+}
+
+void ButterflyJoystick::end()
+{
+  for(uint8_t i = 0; i < 5; i++)
+  {
+    detachPinChangeInterrupt(joystickPins[i]);
+    pinMode(joystickPins[i], INPUT);
+  }
+}
+
+// Events waiting to be read
+uint8_t ButterflyJoystick::available()
+{
+  update();
+  return _events.available();
+}
+
+// The next event, or JOYSTICK_NONE if there are none
+uint8_t ButterflyJoystick::read()
+{
+  uint8_t event;
+
+  update();
+  if(!_events.pop(event))
+    return JOYSTICK_NONE;
+  return event;
+}
+
+// Whether button is held down now, after debouncing
+bool ButterflyJoystick::pressed(uint8_t button)
+{
+  update();
+  return button >= JOYSTICK_UP && button <= JOYSTICK_PUSH && (_state & (1 << (button - 1)));
+}
+
+// Sample the pins if they have changed and are due, and queue what came
+// of it. available() and read() call this too
+void ButterflyJoystick::update()
+{
+  unsigned long now = millis();
+
+  // Only the button pressed last gives long presses and repeats
+  if(_held && (long)(now - _nextEvent) >= 0)
+  {
+    _events.push((_repeating ? JOYSTICK_REPEAT : JOYSTICK_LONG_PRESS) | _held);
+    _repeating = true;
+    _nextEvent = now + JOYSTICK_REPEAT_MS;
+  }
+
+  if(!joystickChanged && settled())
+    return;
+  if(now - _lastSample < JOYSTICK_SAMPLE_MS)
+    return;
+  _lastSample = now;
+  joystickChanged = false;
+
+  // Each count goes up for every sample a button is down and down for
+  // every one it's up, and the button changes state at either end
+  for(uint8_t i = 0; i < 5; i++)
+  {
+    uint8_t bit = 1 << i;
+
+    if(!digitalRead(joystickPins[i]))
+    {
+      if(_count[i] < JOYSTICK_DEBOUNCE && ++_count[i] == JOYSTICK_DEBOUNCE && !(_state & bit))
+      {
+        _state |= bit;
+        _events.push(JOYSTICK_PRESS | (i + 1));
+        _held = i + 1;
+        _repeating = false;
+        _nextEvent = now + JOYSTICK_LONG_MS;
+      }
+    }
+    else if(_count[i] && !--_count[i] && (_state & bit))
+    {
+      _state &= ~bit;
+      _events.push(JOYSTICK_RELEASE | (i + 1));
+      if(_held == i + 1)
+        _held = JOYSTICK_NONE;
+    }
+  }
+}
+
+// Milliseconds until update() has something to do, 0 if it has now, or
+// JOYSTICK_NO_UPDATE if it waits for the joystick to move
+unsigned long ButterflyJoystick::nextUpdate()
+{
+  unsigned long now = millis(), wait = JOYSTICK_NO_UPDATE;
+
+  if(joystickChanged || !settled())
+  {
+    unsigned long elapsed = now - _lastSample;
+    wait = elapsed >= JOYSTICK_SAMPLE_MS ? 0 : JOYSTICK_SAMPLE_MS - elapsed;
+  }
+  if(_held)
+  {
+    long left = _nextEvent - now;
+    if(left <= 0)
+      return 0;
+    if((unsigned long)left < wait)
+      wait = left;
+  }
+  return wait;
+}
+
+// Every count at one end or the other
+bool ButterflyJoystick::settled()
+{
+  for(uint8_t i = 0; i < 5; i++)
+    if(_count[i] && _count[i] != JOYSTICK_DEBOUNCE)
+      return false;
+  return true;
+}
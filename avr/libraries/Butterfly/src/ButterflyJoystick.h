@@ -0,0 +1,91 @@
+/* AVR Butterfly joystick library
+ *
+ * The five-way joystick pulls PB6 (up), PB7 (down), PE2 (left), PE3
+ * (right) or PB4 (pushed in) low. The pins wake the CPU with pin change
+ * interrupts, and update() then samples them every few milliseconds
+ * until they are steady. A press, a release, a long press and repeats
+ * while the joystick is held come out of read() as events.
+ *
+ * Between events nothing needs to run, so a sketch can sleep with
+ * idle(joystick.nextUpdate()) and be woken by the joystick. This uses
+ * attachPinChangeInterrupt(), which can't be used together with
+ * SoftwareSerial.
+ */
+#include "Arduino.h"
+#include "RingBuffer.h"
+
+#ifndef BUTTERFLYJOYSTICK_h
+#define BUTTERFLYJOYSTICK_h
+
+// Buttons, in the low bits of an event
+#define JOYSTICK_NONE   0
+#define JOYSTICK_UP     1
+#define JOYSTICK_DOWN   2
+#define JOYSTICK_LEFT   3
+#define JOYSTICK_RIGHT  4
+#define JOYSTICK_PUSH   5
+
+// Event types, in the high bits
+#define JOYSTICK_PRESS      0x10
+#define JOYSTICK_RELEASE    0x20
+#define JOYSTICK_LONG_PRESS 0x30
+#define JOYSTICK_REPEAT     0x40
+
+#define joystickButton(event) ((event) & 0x0f)
+#define joystickEvent(event)  ((event) & 0xf0)
+
+// Milliseconds between samples, and samples in a row a button has to be
+// pressed or released for to count
+#ifndef JOYSTICK_SAMPLE_MS
+#define JOYSTICK_SAMPLE_MS 5
+#endif
+#ifndef JOYSTICK_DEBOUNCE
+#define JOYSTICK_DEBOUNCE 4
+#endif
+
+// A long press after this many milliseconds held, then a repeat every
+// JOYSTICK_REPEAT_MS
+#ifndef JOYSTICK_LONG_MS
+#define JOYSTICK_LONG_MS 800
+#endif
+#ifndef JOYSTICK_REPEAT_MS
+#define JOYSTICK_REPEAT_MS 200
+#endif
+
+// Events kept until read, a power of 2
+#ifndef JOYSTICK_EVENTS
+#define JOYSTICK_EVENTS 8
+#endif
+
+// nextUpdate() when only the joystick moving can bring an event
+#define JOYSTICK_NO_UPDATE 0xFFFFFFFFUL
+
+
+class ButterflyJoystick
+{
+  public:
+    // Public methods
+    void begin();
+    void end();
+    uint8_t available();
+    uint8_t read();
+    bool pressed(uint8_t button);
+
+    void update();
+    unsigned long nextUpdate();
+
+  private:
+    // Private methods
+    bool settled();
+
+    // Private variables
+    uint8_t _count[5];
+    uint8_t _state;
+    uint8_t _held;
+    bool _repeating;
+    unsigned long _lastSample;
+    unsigned long _nextEvent;
+    RingBuffer<JOYSTICK_EVENTS> _events;
+};
+
+#endif
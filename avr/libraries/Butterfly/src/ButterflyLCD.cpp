@@ -22,6 +22,23 @@
 #include "ButterflyLCD.h"
 
 
+/*
+  NAME:      | requestUpdate (static, inline)
+  PURPOSE:   | Asks the start of frame interrupt to update the display. The interrupt is only
+             | enabled while there is something to show or a message is scrolling, so the CPU
+             | can stay asleep the rest of the time
+  ARGUMENTS: | None
+  RETURNS:   | None
+*/
+static inline void requestUpdate(void)
+{
+  UpdateDisplay = true;
+
+  // Writing LCDIF back as one would clear a pending interrupt
+  LCDCRA = (LCDCRA & ~(1 << LCDIF)) | (1 << LCDIE);
+}
+
+
 /*
   NAME:      | ButterflyLCD
   PURPOSE:   | Constructs ButterflyLCD
@@ -51,8 +68,9 @@ void ButterflyLCD::begin(void)
   // Set LCD prescaler to give a framerate of 64Hz:
   LCDFRR  = (0 << LCDPS0) | (3 << LCDCD0);
 
-  // Enable LCD and set low power waveform, enable start of frame interrupt:
-  LCDCRA  = (1 << LCDEN) | (1 << LCDAB) | (1 << LCDIE);
+  // Enable LCD and set low power waveform. The start of frame interrupt is
+  // enabled when the display has to be updated:
+  LCDCRA  = (1 << LCDEN) | (1 << LCDAB);
 
   // Clear LCD
   clear();
@@ -83,7 +101,57 @@ void ButterflyLCD::setCursor(uint8_t position)
 */
 void ButterflyLCD::setContrast(uint8_t level)
 {
-  LCDCCR = (0x0f & level);
+  LCDCCR = (LCDCCR & 0xf0) | (0x0f & level);
+}
+
+
+/*
+  NAME:      | setDriveTime
+  PURPOSE:   | Sets how long the segments are driven each frame, LCD_DRIVE_70US to LCD_DRIVE_1150US
+             | or LCD_DRIVE_HALF_FRAME. A short drive time saves power, and may need a higher
+             | contrast level to make up for it
+  ARGUMENTS: | time (default LCD_DRIVE_300US)
+  RETURNS:   | None
+*/
+void ButterflyLCD::setDriveTime(uint8_t time)
+{
+  LCDCCR = (LCDCCR & ~(7 << LCDDC0)) | ((time & 7) << LCDDC0);
+}
+
+
+/*
+  NAME:      | setFrameRate
+  PURPOSE:   | Sets the frame rate to the one nearest to rate (Hz) that the 32.768 kHz clock can
+             | be divided down to. Lower rates take less power but flicker below about 30 Hz,
+             | and scrolling slows down with them
+  ARGUMENTS: | rate (default 64)
+  RETURNS:   | None
+*/
+void ButterflyLCD::setFrameRate(uint8_t rate)
+{
+  // The LCD clock is divided by 8 for 1/4 duty, by the prescaler (16, then
+  // 64 to 4096) and by LCDCD + 1
+  uint8_t best = (3 << LCDCD0);
+  uint16_t bestError = 0xffff;
+
+  for(uint8_t prescaler = 0; prescaler < 8; prescaler++)
+  {
+    uint16_t n = prescaler ? 32 << prescaler : 16;
+
+    for(uint8_t divider = 1; divider <= 8; divider++)
+    {
+      uint16_t frameRate = 4096 / (n * divider);
+      uint16_t error = frameRate > rate ? frameRate - rate : rate - frameRate;
+
+      if(error < bestError)
+      {
+        bestError = error;
+        best = (prescaler << LCDPS0) | ((divider - 1) << LCDCD0);
+      }
+    }
+  }
+
+  LCDFRR = best;
 }
 
 
@@ -96,7 +164,8 @@ void ButterflyLCD::setContrast(uint8_t level)
 void ButterflyLCD::wait()
 {
   // Wait for the LCD to be updated by the ISR
-  while(UpdateDisplay == true);
+  while(UpdateDisplay == true)
+    yield();
 }
 
 
@@ -159,7 +228,7 @@ void ButterflyLCD::print(const char Data[])//const char *Data)
   StrStart      = 0;
   StrEnd        = LoadB;
   ScrollCount   = LCD_SCROLLCOUNT_DEFAULT + LCD_DELAYCOUNT_DEFAULT;
-  UpdateDisplay = true;
+  requestUpdate();
 
   // Wait for the ISR to occur
   wait();
@@ -207,8 +276,8 @@ void ButterflyLCD::clear(void)
   StrStart      = 0;
   StrEnd        = LCD_DISPLAY_SIZE + 1;
   ScrollCount   = LCD_SCROLLCOUNT_DEFAULT + LCD_DELAYCOUNT_DEFAULT;
-  UpdateDisplay = true;
   clearDisplay  = true;
+  requestUpdate();
 
   // Wait for the ISR to occur
 //  wait();
@@ -224,7 +293,7 @@ void ButterflyLCD::clear(void)
 void ButterflyLCD::showColons(const uint8_t ColonsOn)
 {
   ShowColons    = ColonsOn;
-  UpdateDisplay = true;
+  requestUpdate();
 
   // Wait for the ISR to occur
   wait();
@@ -298,7 +367,7 @@ void ButterflyLCD::appendc(char Data)
   StrStart      = 0;
   StrEnd        = LoadB;
   ScrollCount   = LCD_SCROLLCOUNT_DEFAULT + LCD_DELAYCOUNT_DEFAULT;
-  UpdateDisplay = true;
+  requestUpdate();
 
   // Wait for the ISR to occur
   wait();
@@ -408,4 +477,9 @@ ISR(LCD_vect)
     clearDisplay = false;
     cursorPosition = previousCursor;
   }
+
+  // The new segments are latched at the start of the next frame without
+  // any help, so unless a message scrolls there's no need to wake up again
+  if (!UpdateDisplay && !(ScrollFlags & LCD_FLAG_SCROLL))
+    LCDCRA &= ~((1 << LCDIE) | (1 << LCDIF));
 }
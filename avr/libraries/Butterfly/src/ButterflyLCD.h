@@ -41,6 +41,17 @@
 #define LCD_FLAG_SCROLL            (1 << 0)
 #define LCD_FLAG_SCROLL_DONE       (1 << 1)
 
+// Drive times for setDriveTime(). Shorter ones take less power but give
+// less contrast
+#define LCD_DRIVE_70US             1
+#define LCD_DRIVE_150US            2
+#define LCD_DRIVE_300US            0
+#define LCD_DRIVE_450US            3
+#define LCD_DRIVE_575US            4
+#define LCD_DRIVE_850US            5
+#define LCD_DRIVE_1150US           6
+#define LCD_DRIVE_HALF_FRAME       7
+
 
 // Butterfly segment table
 const uint16_t PROGMEM LCD_SegTable[] = 
@@ -123,6 +134,8 @@ class ButterflyLCD
     // Public methods
     void begin(void);
     void setContrast(uint8_t level = 0x0f);
+    void setDriveTime(uint8_t time = LCD_DRIVE_300US);
+    void setFrameRate(uint8_t rate = 64);
     void setCursor(uint8_t position = 0);
     void wait();
     void print(String);
@@ -0,0 +1,113 @@
+#include "ButterflyRTC.h"
+#include "Arduino.h"
+
+
+// Days before each month in a year that isn't a leap year
+static const uint16_t PROGMEM daysBeforeMonth[] =
+{
+  0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334
+};
+
+
+void ButterflyRTC::begin()
+{
+  rtcBegin();
+}
+
+void ButterflyRTC::setTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second)
+{
+  rtcSetTime(toSeconds(year, month, day, hour, minute, second));
+}
+
+void ButterflyRTC::setTime(unsigned long seconds)
+{
+  rtcSetTime(seconds);
+}
+
+void ButterflyRTC::getTime(ButterflyTime &time)
+{
+  fromSeconds(rtcTime(), time);
+}
+
+unsigned long ButterflyRTC::now()
+{
+  return rtcTime();
+}
+
+// 1/1024 s since the last whole second
+uint16_t ButterflyRTC::subseconds()
+{
+  return rtcSubseconds();
+}
+
+// Go off the next time the clock shows this time of day
+void ButterflyRTC::setAlarm(uint8_t hour, uint8_t minute, uint8_t second, void (*callback)(void))
+{
+  unsigned long t = rtcTime();
+  unsigned long alarm = t - t % 86400UL + hour * 3600UL + minute * 60U + second;
+
+  if(alarm <= t)
+    alarm += 86400UL;
+  rtcSetAlarm(alarm, callback);
+}
+
+void ButterflyRTC::setAlarmIn(unsigned long seconds, void (*callback)(void))
+{
+  rtcSetAlarm(rtcTime() + seconds, callback);
+}
+
+void ButterflyRTC::clearAlarm()
+{
+  rtcClearAlarm();
+}
+
+bool ButterflyRTC::alarmSet()
+{
+  return rtcAlarmSet();
+}
+
+unsigned long ButterflyRTC::toSeconds(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second)
+{
+  uint8_t y = year - 2000;
+  uint16_t days = y * 365U + (y + 3) / 4 + pgm_read_word(&daysBeforeMonth[month - 1]) + day - 1;
+
+  // Every year in 2000-2099 divisible by four is a leap year
+  if(month > 2 && !(y & 3))
+    days++;
+
+  return days * 86400UL + hour * 3600UL + minute * 60U + second;
+}
+
+void ButterflyRTC::fromSeconds(unsigned long seconds, ButterflyTime &time)
+{
+  uint16_t days = seconds / 86400UL;
+  unsigned long rest = seconds % 86400UL;
+  uint8_t y, month;
+  uint16_t yearDays;
+
+  time.second = rest % 60;
+  rest /= 60;
+  time.minute = rest % 60;
+  time.hour = rest / 60;
+  time.weekday = days % 7;
+
+  for(y = 0; ; y++)
+  {
+    yearDays = (y & 3) ? 365 : 366;
+    if(days < yearDays)
+      break;
+    days -= yearDays;
+  }
+  time.year = 2000 + y;
+
+  for(month = 11; month > 0; month--)
+  {
+    uint16_t before = pgm_read_word(&daysBeforeMonth[month]);
+    if(month > 1 && !(y & 3))
+      before++;
+    if(days >= before)
+      break;
+  }
+  time.month = month + 1;
+  time.day = days - pgm_read_word(&daysBeforeMonth[month]) - (month > 1 && !(y & 3)) + 1;
+}
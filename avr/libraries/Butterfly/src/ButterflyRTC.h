@@ -0,0 +1,45 @@
+/* AVR Butterfly real-time clock library
+ *
+ * Calendar time on top of the core's RTC (rtcBegin() and friends), which
+ * counts the 32.768 kHz watch crystal on Timer2 and keeps going in
+ * power-save sleep. Time is kept as seconds since 2000-01-01 00:00:00,
+ * and dates from 2000 to 2099 are supported.
+ */
+#include "Arduino.h"
+
+#ifndef BUTTERFLYRTC_h
+#define BUTTERFLYRTC_h
+
+struct ButterflyTime
+{
+  uint16_t year;   // 2000 to 2099
+  uint8_t month;   // 1 to 12
+  uint8_t day;     // 1 to 31
+  uint8_t hour;
+  uint8_t minute;
+  uint8_t second;
+  uint8_t weekday; // 0 is Saturday, as 2000-01-01 was one
+};
+
+
+class ButterflyRTC
+{
+  public:
+    // Public methods
+    void begin();
+    void setTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second);
+    void setTime(unsigned long seconds);
+    void getTime(ButterflyTime &time);
+    unsigned long now();
+    uint16_t subseconds();
+
+    void setAlarm(uint8_t hour, uint8_t minute, uint8_t second, void (*callback)(void) = 0);
+    void setAlarmIn(unsigned long seconds, void (*callback)(void) = 0);
+    void clearAlarm();
+    bool alarmSet();
+
+    static unsigned long toSeconds(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second);
+    static void fromSeconds(unsigned long seconds, ButterflyTime &time);
+};
+
+#endif
@@ -0,0 +1,72 @@
+/*
+  Dataflash Server
+
+ Serves the contents of the Butterfly's onboard dataflash, such as a data
+ log, as a plain text download. The file is sent with an EthernetTransfer,
+ a few bytes at a time, so loop() keeps running while a client downloads it
+ and the sketch never needs a page sized buffer in RAM.
+
+ Circuit:
+ * W5100, W5200 or W5500 module attached to the SPI pins
+ * The module's CS can't share PB0 with the dataflash. Wire it to another
+   pin and build with -DETHERNET_CS_PIN=<pin> added to the compiler flags
+
+ */
+
+#include <SPI.h>
+#include <Ethernet.h>
+#include <EthernetTransfer.h>
+#include <Butterfly.h>
+
+// Pages of dataflash to serve
+const uint16_t firstPage = 0;
+const uint16_t pageCount = 64;
+
+byte mac[] = {
+  0xDE, 0xAD, 0xBE, 0xEF, 0xFE, 0xED
+};
+IPAddress ip(192, 168, 1, 177);
+
+EthernetServer server(80);
+EthernetClient client;
+EthernetTransfer transfer;
+ButterflyDataflash flash;
+
+// Called by the transfer whenever it has room for more data
+uint16_t readFlash(uint32_t offset, uint8_t *buf, uint16_t len) {
+  flash.ContFlashReadEnable(offset / PageSize, offset % PageSize);
+  for (uint16_t i = 0; i < len; i++) {
+    buf[i] = flash.ReadNextByte();
+  }
+  flash.Deactivate();
+  return len;
+}
+
+void setup() {
+  Ethernet.begin(mac, ip);
+  server.begin();
+}
+
+void loop() {
+  if (!client) {
+    client = server.available();
+    if (client) {
+      // skip the request, we only serve one file
+      while (client.available()) {
+        client.read();
+      }
+      client.println("HTTP/1.1 200 OK");
+      client.println("Content-Type: text/plain");
+      client.println("Connection: close");
+      client.println();
+      transfer.begin(client, readFlash, (uint32_t)firstPage * PageSize,
+                     (uint32_t)pageCount * PageSize);
+    }
+  }
+  else if (transfer.poll() != 0) {
+    // done, or the client went away
+    client.stop();
+  }
+
+  // other work goes here while the download is running
+}
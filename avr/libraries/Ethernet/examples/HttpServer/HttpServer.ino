@@ -0,0 +1,92 @@
+/*
+  HTTP Server
+
+ A small web server built on EthernetHttpServer. The front page is stored
+ in flash and sent a piece at a time, /status is written by a handler as it
+ goes, and /led takes a POSTed value. Connections are kept alive between
+ requests, so a browser reloading the page doesn't reconnect every time.
+
+ Circuit:
+ * W5100, W5200 or W5500 module attached to the SPI pins
+ * An LED on LED_BUILTIN
+
+ */
+
+#include <SPI.h>
+#include <Ethernet.h>
+#include <EthernetHttpServer.h>
+
+byte mac[] = {
+  0xDE, 0xAD, 0xBE, 0xEF, 0xFE, 0xED
+};
+IPAddress ip(192, 168, 1, 177);
+
+const int ledPin = LED_BUILTIN;
+
+EthernetHttpServer http(80);
+
+// The front page, headers and all, lives in flash
+const char indexHeaders[] PROGMEM =
+  "HTTP/1.1 200 OK\r\n"
+  "Content-Type: text/html\r\n"
+  "Cache-Control: max-age=3600\r\n";
+const uint8_t indexBody[] PROGMEM =
+  "<html><body><h1>Butterfly</h1>"
+  "<p><a href=\"/status\">Status</a></p>"
+  "<form method=\"post\" action=\"/led\">"
+  "<input name=\"on\" value=\"1\"><input type=\"submit\" value=\"LED\">"
+  "</form></body></html>";
+const HttpAsset indexPage PROGMEM = {
+  indexHeaders, indexBody, sizeof(indexBody) - 1
+};
+
+const char textPlain[] PROGMEM = "text/plain";
+
+// The length isn't known up front, so this is sent chunked
+void status(EthernetHttpServer &http) {
+  http.beginResponse(200, textPlain);
+  http.print("Uptime: ");
+  http.print(millis() / 1000);
+  http.println(" s");
+  for (int pin = A0; pin <= A7; pin++) {
+    http.print("A");
+    http.print(pin - A0);
+    http.print(": ");
+    http.println(analogRead(pin));
+  }
+  http.endResponse();
+}
+
+// Expects a body like "on=1"; only the last character matters
+void led(EthernetHttpServer &http) {
+  int c = 0;
+  while (http.available()) {
+    c = http.read();
+  }
+  digitalWrite(ledPin, c == '1' ? HIGH : LOW);
+
+  http.beginResponse(200, textPlain, 3);
+  http.print("OK\n");
+}
+
+const char rootPath[] PROGMEM = "/";
+const char statusPath[] PROGMEM = "/status";
+const char ledPath[] PROGMEM = "/led";
+
+const HttpRoute routes[] PROGMEM = {
+  { HTTP_GET,  rootPath,   0,      &indexPage },
+  { HTTP_GET,  statusPath, status, 0 },
+  { HTTP_POST, ledPath,    led,    0 },
+};
+
+void setup() {
+  pinMode(ledPin, OUTPUT);
+  Ethernet.begin(mac, ip);
+  http.begin(routes, sizeof(routes) / sizeof(routes[0]));
+}
+
+void loop() {
+  http.poll();
+
+  // other work goes here
+}
@@ -0,0 +1,61 @@
+/*
+  Telemetry Sender
+
+ Samples the Butterfly's light sensor every 10 ms and sends the readings
+ to a collector over UDP. Each reading is a small record with a header, the
+ value and a checksum; EthernetTelemetry packs the records into as few
+ datagrams as it can, so the collector sees one packet per second or per
+ full datagram rather than a hundred packets a second.
+
+ Circuit:
+ * W5100, W5200 or W5500 module attached to the SPI pins
+
+ */
+
+#include <SPI.h>
+#include <Ethernet.h>
+#include <EthernetTelemetry.h>
+
+byte mac[] = {
+  0xDE, 0xAD, 0xBE, 0xEF, 0xFE, 0xED
+};
+IPAddress ip(192, 168, 1, 177);
+IPAddress collector(192, 168, 1, 1);
+const unsigned int collectorPort = 8888;
+
+EthernetTelemetry telemetry;
+
+struct RecordHeader {
+  uint8_t type;
+  uint8_t sequence;
+  uint32_t time;
+};
+
+uint8_t sequence;
+unsigned long lastSample;
+
+void setup() {
+  Ethernet.begin(mac, ip);
+  // batches of up to 512 bytes, sent at least once a second
+  telemetry.begin(collector, collectorPort, 0, 512, 1000);
+}
+
+void loop() {
+  if (millis() - lastSample >= 10) {
+    lastSample = millis();
+
+    RecordHeader header = { 1, sequence++, lastSample };
+    uint16_t value = analogRead(LIGHT_SENSOR);
+    uint8_t check = header.type ^ header.sequence ^ (value >> 8) ^ value;
+
+    // the three pieces are copied into the datagram in one go
+    EthernetTelemetryField fields[] = {
+      { &header, sizeof(header) },
+      { &value, sizeof(value) },
+      { &check, sizeof(check) },
+    };
+    telemetry.add(fields, 3);
+  }
+
+  telemetry.poll();
+}
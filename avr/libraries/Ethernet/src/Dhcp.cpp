@@ -10,6 +10,25 @@
 #include "utility/util.h"
 
 int DhcpClass::beginWithDHCP(uint8_t *mac, unsigned long timeout, unsigned long responseTimeout)
+{
+    init_DHCP(mac, timeout, responseTimeout);
+    return request_DHCP_lease();
+}
+
+// Start looking for a lease without waiting for it. The exchange is then
+// carried on by checkLease(), which returns DHCP_CHECK_BEGIN_OK or
+// DHCP_CHECK_BEGIN_FAIL once it is over.
+//return:0 if no socket was available, 1 if the request was started
+int DhcpClass::beginAsync(uint8_t *mac, unsigned long timeout, unsigned long responseTimeout)
+{
+    init_DHCP(mac, timeout, responseTimeout);
+    if (!start_DHCP_request())
+        return 0;
+    _dhcp_pending = DHCP_CHECK_BEGIN_FAIL;
+    return 1;
+}
+
+void DhcpClass::init_DHCP(uint8_t *mac, unsigned long timeout, unsigned long responseTimeout)
 {
     _dhcpLeaseTime=0;
     _dhcpT1=0;
@@ -23,7 +42,7 @@ int DhcpClass::beginWithDHCP(uint8_t *mac, unsigned long timeout, unsigned long
 
     memcpy((void*)_dhcpMacAddr, (void*)mac, 6);
     _dhcp_state = STATE_DHCP_START;
-    return request_DHCP_lease();
+    _dhcp_pending = DHCP_CHECK_NONE;
 }
 
 void DhcpClass::reset_DHCP_lease(){
@@ -33,11 +52,19 @@ void DhcpClass::reset_DHCP_lease(){
 
 //return:0 on error, 1 if request is sent and response is received
 int DhcpClass::request_DHCP_lease(){
-    
-    uint8_t messageType = 0;
-  
-    
-  
+
+    if (!start_DHCP_request())
+        return 0;
+
+    int result;
+    while ((result = poll_DHCP_request()) < 0)
+        delay(50);
+    return result;
+}
+
+//return:0 if no socket was available, 1 if the request was started
+int DhcpClass::start_DHCP_request(){
+
     // Pick an initial transaction ID
     _dhcpTransactionId = random(1UL, 2000UL);
     _dhcpInitialTransactionId = _dhcpTransactionId;
@@ -50,76 +77,88 @@ int DhcpClass::request_DHCP_lease(){
     }
     
     presend_DHCP();
-    
-    int result = 0;
-    
-    unsigned long startTime = millis();
-    
-    while(_dhcp_state != STATE_DHCP_LEASED)
+
+    _requestStartMillis = millis();
+    return 1;
+}
+
+// Advance the exchange started by start_DHCP_request() by one step. Never
+// waits for the server; a missing reply is noticed on a later call.
+//return:-1 while in progress, 0 on error, 1 once a lease is obtained
+int DhcpClass::poll_DHCP_request(){
+
+    uint8_t messageType = 0;
+    int result = -1;
+    unsigned long startTime = _requestStartMillis;
+
+    if(_dhcp_state == STATE_DHCP_START)
     {
-        if(_dhcp_state == STATE_DHCP_START)
+        _dhcpTransactionId++;
+
+        send_DHCP_MESSAGE(DHCP_DISCOVER, ((millis() - startTime) / 1000));
+        _dhcp_state = STATE_DHCP_DISCOVER;
+        _responseStartMillis = millis();
+    }
+    else if(_dhcp_state == STATE_DHCP_REREQUEST){
+        _dhcpTransactionId++;
+        send_DHCP_MESSAGE(DHCP_REQUEST, ((millis() - startTime)/1000));
+        _dhcp_state = STATE_DHCP_REQUEST;
+        _responseStartMillis = millis();
+    }
+    else if(_dhcp_state == STATE_DHCP_DISCOVER)
+    {
+        uint32_t respId;
+        messageType = parseDHCPResponse(_responseTimeout, respId);
+        if(messageType == DHCP_OFFER)
         {
-            _dhcpTransactionId++;
-            
-            send_DHCP_MESSAGE(DHCP_DISCOVER, ((millis() - startTime) / 1000));
-            _dhcp_state = STATE_DHCP_DISCOVER;
-        }
-        else if(_dhcp_state == STATE_DHCP_REREQUEST){
-            _dhcpTransactionId++;
-            send_DHCP_MESSAGE(DHCP_REQUEST, ((millis() - startTime)/1000));
+            // We'll use the transaction ID that the offer came with,
+            // rather than the one we were up to
+            _dhcpTransactionId = respId;
+            send_DHCP_MESSAGE(DHCP_REQUEST, ((millis() - startTime) / 1000));
             _dhcp_state = STATE_DHCP_REQUEST;
+            _responseStartMillis = millis();
         }
-        else if(_dhcp_state == STATE_DHCP_DISCOVER)
+    }
+    else if(_dhcp_state == STATE_DHCP_REQUEST)
+    {
+        uint32_t respId;
+        messageType = parseDHCPResponse(_responseTimeout, respId);
+        if(messageType == DHCP_ACK)
         {
-            uint32_t respId;
-            messageType = parseDHCPResponse(_responseTimeout, respId);
-            if(messageType == DHCP_OFFER)
-            {
-                // We'll use the transaction ID that the offer came with,
-                // rather than the one we were up to
-                _dhcpTransactionId = respId;
-                send_DHCP_MESSAGE(DHCP_REQUEST, ((millis() - startTime) / 1000));
-                _dhcp_state = STATE_DHCP_REQUEST;
+            _dhcp_state = STATE_DHCP_LEASED;
+            result = 1;
+            //use default lease time if we didn't get it
+            if(_dhcpLeaseTime == 0){
+                _dhcpLeaseTime = DEFAULT_LEASE;
             }
-        }
-        else if(_dhcp_state == STATE_DHCP_REQUEST)
-        {
-            uint32_t respId;
-            messageType = parseDHCPResponse(_responseTimeout, respId);
-            if(messageType == DHCP_ACK)
-            {
-                _dhcp_state = STATE_DHCP_LEASED;
-                result = 1;
-                //use default lease time if we didn't get it
-                if(_dhcpLeaseTime == 0){
-                    _dhcpLeaseTime = DEFAULT_LEASE;
-                }
-                // Calculate T1 & T2 if we didn't get it
-                if(_dhcpT1 == 0){
-                    // T1 should be 50% of _dhcpLeaseTime
-                    _dhcpT1 = _dhcpLeaseTime >> 1;
-                }
-                if(_dhcpT2 == 0){
-                    // T2 should be 87.5% (7/8ths) of _dhcpLeaseTime
-                    _dhcpT2 = _dhcpLeaseTime - (_dhcpLeaseTime >> 3);
-                }
-                _renewInSec = _dhcpT1;
-                _rebindInSec = _dhcpT2;
+            // Calculate T1 & T2 if we didn't get it
+            if(_dhcpT1 == 0){
+                // T1 should be 50% of _dhcpLeaseTime
+                _dhcpT1 = _dhcpLeaseTime >> 1;
+            }
+            if(_dhcpT2 == 0){
+                // T2 should be 87.5% (7/8ths) of _dhcpLeaseTime
+                _dhcpT2 = _dhcpLeaseTime - (_dhcpLeaseTime >> 3);
             }
-            else if(messageType == DHCP_NAK)
-                _dhcp_state = STATE_DHCP_START;
+            _renewInSec = _dhcpT1;
+            _rebindInSec = _dhcpT2;
         }
-        
-        if(messageType == 255)
-        {
-            messageType = 0;
+        else if(messageType == DHCP_NAK)
             _dhcp_state = STATE_DHCP_START;
-        }
-        
-        if(result != 1 && ((millis() - startTime) > _timeout))
-            break;
     }
     
+    if(messageType == 255)
+    {
+        messageType = 0;
+        _dhcp_state = STATE_DHCP_START;
+    }
+    
+    if(result != 1 && ((millis() - startTime) > _timeout))
+        result = 0;
+
+    if(result < 0)
+        return result;
+
     // We're done with the socket now
     _dhcpUdpSocket.stop();
     _dhcpTransactionId++;
@@ -255,15 +294,15 @@ uint8_t DhcpClass::parseDHCPResponse(unsigned long responseTimeout, uint32_t& tr
     uint8_t type = 0;
     uint8_t opt_len = 0;
      
-    unsigned long startTime = millis();
-
-    while(_dhcpUdpSocket.parsePacket() <= 0)
+    if(_dhcpUdpSocket.parsePacket() <= 0)
     {
-        if((millis() - startTime) > responseTimeout)
+        // Nothing yet; give up on this message once the server has had
+        // responseTimeout to answer it
+        if((millis() - _responseStartMillis) > responseTimeout)
         {
             return 255;
         }
-        delay(50);
+        return 0;
     }
     // start reading in the packet
     RIP_MSG_FIXED fixedMsg;
@@ -390,6 +429,10 @@ uint8_t DhcpClass::parseDHCPResponse(unsigned long responseTimeout, uint32_t& tr
     2/DHCP_CHECK_RENEW_OK: renew success
     3/DHCP_CHECK_REBIND_FAIL: rebind fail
     4/DHCP_CHECK_REBIND_OK: rebind success
+    5/DHCP_CHECK_BEGIN_FAIL: beginAsync failed
+    6/DHCP_CHECK_BEGIN_OK: beginAsync success
+    A renew or rebind is only started here; later calls carry it on and
+    report how it ended, so this never blocks.
 */
 int DhcpClass::checkLease(){
     int rc = DHCP_CHECK_NONE;
@@ -418,18 +461,32 @@ int DhcpClass::checkLease(){
             _rebindInSec -= elapsed;
     }
 
+    // carry on with a request already in flight
+    if (_dhcp_pending != DHCP_CHECK_NONE) {
+        int result = poll_DHCP_request();
+        if (result < 0)
+            return DHCP_CHECK_NONE;
+        rc = _dhcp_pending + result;
+        _dhcp_pending = DHCP_CHECK_NONE;
+        return rc;
+    }
+
     // if we have a lease but should renew, do it
     if (_renewInSec == 0 &&_dhcp_state == STATE_DHCP_LEASED) {
         _dhcp_state = STATE_DHCP_REREQUEST;
-        rc = 1 + request_DHCP_lease();
+        if (!start_DHCP_request())
+            return DHCP_CHECK_RENEW_FAIL;
+        _dhcp_pending = DHCP_CHECK_RENEW_FAIL;
     }
 
     // if we have a lease or is renewing but should bind, do it
-    if (_rebindInSec == 0 && (_dhcp_state == STATE_DHCP_LEASED || _dhcp_state == STATE_DHCP_START)) {
+    else if (_rebindInSec == 0 && (_dhcp_state == STATE_DHCP_LEASED || _dhcp_state == STATE_DHCP_START)) {
         // this should basically restart completely
         _dhcp_state = STATE_DHCP_START;
         reset_DHCP_lease();
-        rc = 3 + request_DHCP_lease();
+        if (!start_DHCP_request())
+            return DHCP_CHECK_REBIND_FAIL;
+        _dhcp_pending = DHCP_CHECK_REBIND_FAIL;
     }
     return rc;
 }
@@ -52,6 +52,8 @@
 #define DHCP_CHECK_RENEW_OK     (2)
 #define DHCP_CHECK_REBIND_FAIL  (3)
 #define DHCP_CHECK_REBIND_OK    (4)
+#define DHCP_CHECK_BEGIN_FAIL   (5)
+#define DHCP_CHECK_BEGIN_OK     (6)
 
 enum
 {
@@ -153,9 +155,15 @@ private:
   unsigned long _timeout;
   unsigned long _responseTimeout;
   unsigned long _lastCheckLeaseMillis;
+  unsigned long _requestStartMillis;
+  unsigned long _responseStartMillis;
   uint8_t _dhcp_state;
+  uint8_t _dhcp_pending;
   EthernetUDP _dhcpUdpSocket;
   
+  void init_DHCP(uint8_t *, unsigned long, unsigned long);
+  int start_DHCP_request();
+  int poll_DHCP_request();
   int request_DHCP_lease();
   void reset_DHCP_lease();
   void presend_DHCP();
@@ -171,6 +179,7 @@ public:
   IPAddress getDnsServerIp();
   
   int beginWithDHCP(uint8_t *, unsigned long timeout = 60000, unsigned long responseTimeout = 4000);
+  int beginAsync(uint8_t *, unsigned long timeout = 60000, unsigned long responseTimeout = 4000);
   int checkLease();
 };
 
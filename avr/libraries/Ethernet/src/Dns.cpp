@@ -40,6 +40,8 @@
 #define LABEL_COMPRESSION_MASK   (0xC0)
 // Port number that DNS servers listen on
 #define DNS_PORT        53
+// How long to wait for the server to answer a query
+#define DNS_TIMEOUT     15000
 
 // Possible return codes from ProcessResponse
 #define SUCCESS          1
@@ -47,11 +49,14 @@
 #define INVALID_SERVER   -2
 #define TRUNCATED        -3
 #define INVALID_RESPONSE -4
+// Status of a query still waiting for its answer
+#define PENDING          0
 
 void DNSClient::begin(const IPAddress& aDNSServer)
 {
     iDNSServer = aDNSServer;
     iRequestId = 0;
+    iStatus = INVALID_RESPONSE;
 }
 
 
@@ -98,13 +103,36 @@ int DNSClient::inet_aton(const char* address, IPAddress& result)
 }
 
 int DNSClient::getHostByName(const char* aHostname, IPAddress& aResult)
+{
+    int ret = startHostByName(aHostname);
+    if (ret != 1)
+    {
+        return ret;
+    }
+
+    while ((ret = checkHostByName(aResult)) == PENDING)
+    {
+        delay(50);
+    }
+    return ret;
+}
+
+int DNSClient::startHostByName(const char* aHostname)
 {
     int ret =0;
 
+    // Drop any query still waiting for its answer
+    if (iStatus == PENDING)
+    {
+        iUdp.stop();
+    }
+    iStatus = INVALID_RESPONSE;
+
     // See if it's a numeric IP address
-    if (inet_aton(aHostname, aResult))
+    if (inet_aton(aHostname, iResult))
     {
         // It is, our work here is done
+        iStatus = SUCCESS;
         return 1;
     }
 
@@ -117,34 +145,24 @@ int DNSClient::getHostByName(const char* aHostname, IPAddress& aResult)
     // Find a socket to use
     if (iUdp.begin(1024+(millis() & 0xF)) == 1)
     {
-        // Try up to three times
-        int retries = 0;
-//        while ((retries < 3) && (ret <= 0))
+        // Send DNS request
+        ret = iUdp.beginPacket(iDNSServer, DNS_PORT);
+        if (ret != 0)
         {
-            // Send DNS request
-            ret = iUdp.beginPacket(iDNSServer, DNS_PORT);
+            // Now output the request data
+            ret = BuildRequest(aHostname);
             if (ret != 0)
             {
-                // Now output the request data
-                ret = BuildRequest(aHostname);
+                // And finally send the request
+                ret = iUdp.endPacket();
                 if (ret != 0)
                 {
-                    // And finally send the request
-                    ret = iUdp.endPacket();
-                    if (ret != 0)
-                    {
-                        // Now wait for a response
-                        int wait_retries = 0;
-                        ret = TIMED_OUT;
-                        while ((wait_retries < 3) && (ret == TIMED_OUT))
-                        {
-                            ret = ProcessResponse(5000, aResult);
-                            wait_retries++;
-                        }
-                    }
+                    // Keep the socket until the answer arrives
+                    iQueryStart = millis();
+                    iStatus = PENDING;
+                    return 1;
                 }
             }
-            retries++;
         }
 
         // We're done with the socket now
@@ -154,6 +172,34 @@ int DNSClient::getHostByName(const char* aHostname, IPAddress& aResult)
     return ret;
 }
 
+int DNSClient::checkHostByName(IPAddress& aResult)
+{
+    if (iStatus == PENDING)
+    {
+        if (iUdp.parsePacket() <= 0)
+        {
+            if ((millis() - iQueryStart) < DNS_TIMEOUT)
+            {
+                return PENDING;
+            }
+            iStatus = TIMED_OUT;
+        }
+        else
+        {
+            iStatus = ProcessResponse(iResult);
+        }
+
+        // We're done with the socket now
+        iUdp.stop();
+    }
+
+    if (iStatus == SUCCESS)
+    {
+        aResult = iResult;
+    }
+    return iStatus;
+}
+
 uint16_t DNSClient::BuildRequest(const char* aName)
 {
     // Build header
@@ -235,18 +281,9 @@ uint16_t DNSClient::BuildRequest(const char* aName)
 }
 
 
-uint16_t DNSClient::ProcessResponse(uint16_t aTimeout, IPAddress& aAddress)
+// Parse the reply picked up by parsePacket()
+int16_t DNSClient::ProcessResponse(IPAddress& aAddress)
 {
-    uint32_t startTime = millis();
-
-    // Wait for a response packet
-    while(iUdp.parsePacket() <= 0)
-    {
-        if((millis() - startTime) > aTimeout)
-            return TIMED_OUT;
-        delay(50);
-    }
-
     // We've had a reply!
     // Read the UDP header
     uint8_t header[DNS_HEADER_SIZE]; // Enough space to reuse for the DNS header
@@ -29,12 +29,29 @@ public:
     */
     int getHostByName(const char* aHostname, IPAddress& aResult);
 
+    /** Send the query for the given hostname without waiting for the answer.
+        @param aHostname Name to be resolved
+        @result 1 if the query was sent (or aHostname was a numeric address),
+                else error code
+    */
+    int startHostByName(const char* aHostname);
+
+    /** Collect the answer to the query sent by startHostByName().
+        @param aResult IPAddress structure to store the returned IP address
+        @result 1 if the name was resolved, 0 while still waiting for the
+                server, else error code
+    */
+    int checkHostByName(IPAddress& aResult);
+
 protected:
     uint16_t BuildRequest(const char* aName);
-    uint16_t ProcessResponse(uint16_t aTimeout, IPAddress& aAddress);
+    int16_t ProcessResponse(IPAddress& aAddress);
 
     IPAddress iDNSServer;
+    IPAddress iResult;
     uint16_t iRequestId;
+    int8_t iStatus;
+    unsigned long iQueryStart;
     EthernetUDP iUdp;
 };
 
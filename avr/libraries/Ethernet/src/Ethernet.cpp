@@ -1,25 +1,18 @@
 #include "utility/w5100.h"
+#include "utility/socket.h"
 #include "Ethernet.h"
 #include "Dhcp.h"
 
-// XXX: don't make assumptions about the value of MAX_SOCK_NUM.
-uint8_t EthernetClass::_state[MAX_SOCK_NUM] = { 
-  0, 0, 0, 0 };
-uint16_t EthernetClass::_server_port[MAX_SOCK_NUM] = { 
-  0, 0, 0, 0 };
+uint8_t EthernetClass::_state[MAX_SOCK_NUM];
+uint16_t EthernetClass::_server_port[MAX_SOCK_NUM];
+uint8_t EthernetClass::_events[MAX_SOCK_NUM];
+volatile uint8_t EthernetClass::_interrupted;
+uint8_t EthernetClass::_useEvents;
 
 int EthernetClass::begin(uint8_t *mac_address, unsigned long timeout, unsigned long responseTimeout)
 {
-  static DhcpClass s_dhcp;
-  _dhcp = &s_dhcp;
-
-
-  // Initialise the basic info
-  W5100.init();
-  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
-  W5100.setMACAddress(mac_address);
-  W5100.setIPAddress(IPAddress(0,0,0,0).raw_address());
-  SPI.endTransaction();
+  if (!initDHCP(mac_address))
+    return 0;
 
   // Now try to get our config info from a DHCP server
   int ret = _dhcp->beginWithDHCP(mac_address, timeout, responseTimeout);
@@ -27,44 +20,74 @@ int EthernetClass::begin(uint8_t *mac_address, unsigned long timeout, unsigned l
   {
     // We've successfully found a DHCP server and got our configuration info, so set things
     // accordingly
-    SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
-    W5100.setIPAddress(_dhcp->getLocalIp().raw_address());
-    W5100.setGatewayIp(_dhcp->getGatewayIp().raw_address());
-    W5100.setSubnetMask(_dhcp->getSubnetMask().raw_address());
-    SPI.endTransaction();
-    _dnsServerAddress = _dhcp->getDnsServerIp();
+    applyDHCP();
   }
 
   return ret;
 }
 
-void EthernetClass::begin(uint8_t *mac_address, IPAddress local_ip)
+int EthernetClass::beginAsync(uint8_t *mac_address, unsigned long timeout, unsigned long responseTimeout)
+{
+  if (!initDHCP(mac_address))
+    return 0;
+
+  return _dhcp->beginAsync(mac_address, timeout, responseTimeout);
+}
+
+int EthernetClass::initDHCP(uint8_t *mac_address)
+{
+  static DhcpClass s_dhcp;
+  _dhcp = &s_dhcp;
+
+
+  // Initialise the basic info
+  if (!W5100.init())
+    return 0;
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  W5100.setMACAddress(mac_address);
+  W5100.setIPAddress(IPAddress(0,0,0,0).raw_address());
+  SPI.endTransaction();
+  return 1;
+}
+
+void EthernetClass::applyDHCP()
+{
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  W5100.setIPAddress(_dhcp->getLocalIp().raw_address());
+  W5100.setGatewayIp(_dhcp->getGatewayIp().raw_address());
+  W5100.setSubnetMask(_dhcp->getSubnetMask().raw_address());
+  SPI.endTransaction();
+  _dnsServerAddress = _dhcp->getDnsServerIp();
+}
+
+int EthernetClass::begin(uint8_t *mac_address, IPAddress local_ip)
 {
   // Assume the DNS server will be the machine on the same network as the local IP
   // but with last octet being '1'
   IPAddress dns_server = local_ip;
   dns_server[3] = 1;
-  begin(mac_address, local_ip, dns_server);
+  return begin(mac_address, local_ip, dns_server);
 }
 
-void EthernetClass::begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server)
+int EthernetClass::begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server)
 {
   // Assume the gateway will be the machine on the same network as the local IP
   // but with last octet being '1'
   IPAddress gateway = local_ip;
   gateway[3] = 1;
-  begin(mac_address, local_ip, dns_server, gateway);
+  return begin(mac_address, local_ip, dns_server, gateway);
 }
 
-void EthernetClass::begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server, IPAddress gateway)
+int EthernetClass::begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server, IPAddress gateway)
 {
   IPAddress subnet(255, 255, 255, 0);
-  begin(mac_address, local_ip, dns_server, gateway, subnet);
+  return begin(mac_address, local_ip, dns_server, gateway, subnet);
 }
 
-void EthernetClass::begin(uint8_t *mac, IPAddress local_ip, IPAddress dns_server, IPAddress gateway, IPAddress subnet)
+int EthernetClass::begin(uint8_t *mac, IPAddress local_ip, IPAddress dns_server, IPAddress gateway, IPAddress subnet)
 {
-  W5100.init();
+  if (!W5100.init())
+    return 0;
   SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
   W5100.setMACAddress(mac);
   W5100.setIPAddress(local_ip.raw_address());
@@ -72,10 +95,16 @@ void EthernetClass::begin(uint8_t *mac, IPAddress local_ip, IPAddress dns_server
   W5100.setSubnetMask(subnet.raw_address());
   SPI.endTransaction();
   _dnsServerAddress = dns_server;
+  return 1;
 }
 
 int EthernetClass::maintain(){
   int rc = DHCP_CHECK_NONE;
+
+  // send TCP data left waiting past the flush timeout
+  for (SOCKET s = 0; s < MAX_SOCK_NUM; s++)
+    flushIdle(s);
+
   if(_dhcp != NULL){
     //we have a pointer to dhcp, use it
     rc = _dhcp->checkLease();
@@ -85,13 +114,9 @@ int EthernetClass::maintain(){
         break;
       case DHCP_CHECK_RENEW_OK:
       case DHCP_CHECK_REBIND_OK:
+      case DHCP_CHECK_BEGIN_OK:
         //we might have got a new IP.
-        SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
-        W5100.setIPAddress(_dhcp->getLocalIp().raw_address());
-        W5100.setGatewayIp(_dhcp->getGatewayIp().raw_address());
-        W5100.setSubnetMask(_dhcp->getSubnetMask().raw_address());
-        SPI.endTransaction();
-        _dnsServerAddress = _dhcp->getDnsServerIp();
+        applyDHCP();
         break;
       default:
         //this is actually a error, it will retry though
@@ -133,4 +158,77 @@ IPAddress EthernetClass::dnsServerIP()
   return _dnsServerAddress;
 }
 
+int EthernetClass::setBufferSize(uint8_t sock, uint8_t txKB, uint8_t rxKB)
+{
+  return W5100.setBufferSize(sock, txKB, rxKB);
+}
+
+void EthernetClass::useInterrupt(uint8_t interruptNum)
+{
+  useInterrupt();
+  // INT stays low while anything is pending, and select() keeps going
+  // until it is released, so every new event gives a falling edge
+  attachInterrupt(interruptNum, handleInterrupt, FALLING);
+}
+
+void EthernetClass::useInterrupt()
+{
+  // Whatever happened before now wasn't seen: have every socket looked at
+  // once, and read the chip on the first select() in case INT is already low
+  for (SOCKET s = 0; s < MAX_SOCK_NUM; s++)
+    _events[s] = SnIR::RECV | SnIR::DISCON | SnIR::CON | SnIR::TIMEOUT;
+  _interrupted = 1;
+  _useEvents = 1;
+
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  W5100.enableSocketInterrupts();
+  SPI.endTransaction();
+}
+
+void EthernetClass::handleInterrupt()
+{
+  _interrupted = 1;
+}
+
+uint8_t EthernetClass::select()
+{
+  if (!_useEvents)
+    return (1 << MAX_SOCK_NUM) - 1;
+
+  if (_interrupted) {
+    _interrupted = 0;
+
+    SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+    uint8_t ir, cleared;
+    do {
+      ir = W5100.readSocketInterrupts();
+      cleared = 0;
+      for (SOCKET s = 0; s < MAX_SOCK_NUM; s++) {
+        if (ir & (1 << s)) {
+          // SEND_OK belongs to whoever is sending, so leave it set
+          uint8_t snir = W5100.readSnIR(s) & (SnIR::RECV | SnIR::DISCON | SnIR::CON | SnIR::TIMEOUT);
+          if (snir) {
+            W5100.writeSnIR(s, snir);
+            _events[s] |= snir;
+            cleared = 1;
+          }
+        }
+      }
+    } while (cleared);
+    SPI.endTransaction();
+
+    // A W5100 holds INT low while SEND_OK is set, so whatever happens until
+    // the sender clears it brings no new edge: look again next time
+    if (ir)
+      _interrupted = 1;
+  }
+
+  uint8_t ready = 0;
+  for (SOCKET s = 0; s < MAX_SOCK_NUM; s++) {
+    if (_events[s])
+      ready |= 1 << s;
+  }
+  return ready;
+}
+
 EthernetClass Ethernet;
@@ -8,23 +8,39 @@
 #include "EthernetServer.h"
 #include "Dhcp.h"
 
+#ifndef MAX_SOCK_NUM
 #define MAX_SOCK_NUM 4
+#endif
 
 class EthernetClass {
 private:
   IPAddress _dnsServerAddress;
   DhcpClass* _dhcp;
+
+  int initDHCP(uint8_t *mac_address);
+  void applyDHCP();
+
+  static volatile uint8_t _interrupted;
+  static uint8_t _useEvents;
 public:
   static uint8_t _state[MAX_SOCK_NUM];
   static uint16_t _server_port[MAX_SOCK_NUM];
+  // Sn_IR bits collected by select() and not yet dealt with
+  static uint8_t _events[MAX_SOCK_NUM];
   // Initialise the Ethernet shield to use the provided MAC address and gain the rest of the
   // configuration through DHCP.
   // Returns 0 if the DHCP configuration failed, and 1 if it succeeded
   int begin(uint8_t *mac_address, unsigned long timeout = 60000, unsigned long responseTimeout = 4000);
-  void begin(uint8_t *mac_address, IPAddress local_ip);
-  void begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server);
-  void begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server, IPAddress gateway);
-  void begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server, IPAddress gateway, IPAddress subnet);
+  // Start DHCP without waiting for it; maintain() carries it on and returns
+  // DHCP_CHECK_BEGIN_OK or DHCP_CHECK_BEGIN_FAIL once it is done.
+  // Returns 1 if the DHCP request was started
+  int beginAsync(uint8_t *mac_address, unsigned long timeout = 60000, unsigned long responseTimeout = 4000);
+  // With a static address. Returns 0 if no chip answered or the buffer
+  // sizes don't fit it, and 1 otherwise
+  int begin(uint8_t *mac_address, IPAddress local_ip);
+  int begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server);
+  int begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server, IPAddress gateway);
+  int begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server, IPAddress gateway, IPAddress subnet);
   int maintain();
 
   IPAddress localIP();
@@ -32,6 +48,24 @@ public:
   IPAddress gatewayIP();
   IPAddress dnsServerIP();
 
+  // Give a socket a TX and RX buffer of the given size in KB; call before
+  // begin(). The sockets not given one share what is left. Returns 0 if
+  // the sizes don't fit; see W5100Class::setBufferSize() for the limits
+  int setBufferSize(uint8_t sock, uint8_t txKB, uint8_t rxKB);
+
+  // Follow socket events through the chip's INT pin, wired to the given
+  // external interrupt. Call after begin(). Sockets without events are then
+  // skipped by EthernetServer::available() and EthernetClient::available()
+  // without any SPI traffic
+  void useInterrupt(uint8_t interruptNum);
+  // Same, for an INT pin on a pin change interrupt: call handleInterrupt()
+  // from its ISR
+  void useInterrupt();
+  static void handleInterrupt();
+  // Returns a bit mask of the sockets with events waiting to be handled,
+  // or of every socket when interrupts aren't in use
+  uint8_t select();
+
   friend class EthernetClient;
   friend class EthernetServer;
 };
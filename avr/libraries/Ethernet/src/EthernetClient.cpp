@@ -14,6 +14,12 @@ extern "C" {
 
 uint16_t EthernetClient::_srcport = 49152;      //Use IANA recommended ephemeral port range 49152-65535
 
+uint8_t EthernetClient::_rxBuffer[MAX_SOCK_NUM][ETHERNET_CLIENT_RX_BUFFER_SIZE];
+uint8_t EthernetClient::_rxHead[MAX_SOCK_NUM];
+uint8_t EthernetClient::_rxCount[MAX_SOCK_NUM];
+uint8_t EthernetClient::_closing;
+uint16_t EthernetClient::_closeStart[MAX_SOCK_NUM];
+
 EthernetClient::EthernetClient() : _sock(MAX_SOCK_NUM) {
 }
 
@@ -36,10 +42,24 @@ int EthernetClient::connect(const char* host, uint16_t port) {
 }
 
 int EthernetClient::connect(IPAddress ip, uint16_t port) {
+  if (!connectAsync(ip, port))
+    return 0;
+
+  int ret;
+  while ((ret = connectStatus()) < 0)
+    delay(1);
+  return ret;
+}
+
+// Open a socket and send the SYN, leaving connectStatus() to follow the
+// handshake. Returns 1 if the connection attempt was started.
+int EthernetClient::connectAsync(IPAddress ip, uint16_t port) {
   if (_sock != MAX_SOCK_NUM)
     return 0;
 
   for (int i = 0; i < MAX_SOCK_NUM; i++) {
+    if (_closing & (1 << i))
+      continue;
     uint8_t s = socketStatus(i);
     if (s == SnSR::CLOSED || s == SnSR::FIN_WAIT || s == SnSR::CLOSE_WAIT) {
       _sock = i;
@@ -53,23 +73,33 @@ int EthernetClient::connect(IPAddress ip, uint16_t port) {
   _srcport++;
   if (_srcport == 0) _srcport = 49152;          //Use IANA recommended ephemeral port range 49152-65535
   socket(_sock, SnMR::TCP, _srcport, 0);
+  resetSocket(_sock);
 
   if (!::connect(_sock, rawIPAddress(ip), port)) {
     _sock = MAX_SOCK_NUM;
     return 0;
   }
 
-  while (status() != SnSR::ESTABLISHED) {
-    delay(1);
-    if (status() == SnSR::CLOSED) {
-      _sock = MAX_SOCK_NUM;
-      return 0;
-    }
-  }
-
   return 1;
 }
 
+// Returns 1 once connected, 0 if the attempt failed (the socket is then
+// released) and -1 while the handshake is still going on. The chip gives
+// up by itself after its retransmission time and count.
+int EthernetClient::connectStatus() {
+  if (_sock == MAX_SOCK_NUM)
+    return 0;
+
+  uint8_t s = status();
+  if (s == SnSR::ESTABLISHED || s == SnSR::CLOSE_WAIT)
+    return 1;
+  if (s == SnSR::CLOSED) {
+    _sock = MAX_SOCK_NUM;
+    return 0;
+  }
+  return -1;
+}
+
 size_t EthernetClient::write(uint8_t b) {
   return write(&b, 1);
 }
@@ -79,77 +109,166 @@ size_t EthernetClient::write(const uint8_t *buf, size_t size) {
     setWriteError();
     return 0;
   }
-  if (!send(_sock, buf, size)) {
+  // Data is gathered in the chip's TX buffer and sent as one segment on
+  // flush(), when the buffer fills or once the flush timeout passes
+  size_t n = sendBuffered(_sock, buf, size);
+  if (!n) {
     setWriteError();
     return 0;
   }
-  return size;
+  if (!getFlushTimeout())
+    ::flush(_sock);
+  return n;
+}
+
+int EthernetClient::availableForWrite() {
+  if (_sock == MAX_SOCK_NUM)
+    return 0;
+  return sendAvailable(_sock);
 }
 
 int EthernetClient::available() {
-  if (_sock != MAX_SOCK_NUM)
+  if (_sock == MAX_SOCK_NUM)
+    return 0;
+  flushIdle(_sock);
+  // Only ask the chip once the read-ahead buffer has run dry
+  if (_rxCount[_sock])
+    return _rxCount[_sock];
+  if (!EthernetClass::_useEvents)
     return recvAvailable(_sock);
-  return 0;
+
+  // With interrupts, only once the chip has said something arrived. The
+  // event stays set until the data has all been read
+  Ethernet.select();
+  if (!(EthernetClass::_events[_sock] & SnIR::RECV))
+    return 0;
+  EthernetClass::_events[_sock] &= ~SnIR::RECV;
+  int ret = recvAvailable(_sock);
+  if (ret > 0)
+    EthernetClass::_events[_sock] |= SnIR::RECV;
+  return ret;
 }
 
 int EthernetClient::read() {
-  uint8_t b;
-  if ( recv(_sock, &b, 1) > 0 )
-  {
-    // recv worked
-    return b;
-  }
-  else
+  if (_sock == MAX_SOCK_NUM)
+    return -1;
+  if (!_rxCount[_sock] && fillBuffer() <= 0)
   {
     // No data available
     return -1;
   }
+  _rxCount[_sock]--;
+  return _rxBuffer[_sock][_rxHead[_sock]++];
 }
 
 int EthernetClient::read(uint8_t *buf, size_t size) {
-  return recv(_sock, buf, size);
+  if (_sock == MAX_SOCK_NUM)
+    return -1;
+
+  // Hand out what was read ahead, then go straight to the chip for the
+  // rest so large reads are not copied twice
+  size_t n = _rxCount[_sock];
+  if (n > size)
+    n = size;
+  memcpy(buf, &_rxBuffer[_sock][_rxHead[_sock]], n);
+  _rxHead[_sock] += n;
+  _rxCount[_sock] -= n;
+
+  if (n < size) {
+    flushIdle(_sock);
+    int ret = recv(_sock, buf + n, size - n);
+    if (ret > 0)
+      n += ret;
+    else if (n == 0)
+      return ret;
+  }
+  return n;
 }
 
 int EthernetClient::peek() {
-  uint8_t b;
-  // Unlike recv, peek doesn't check to see if there's any data available, so we must
-  if (!available())
+  if (_sock == MAX_SOCK_NUM)
     return -1;
-  ::peek(_sock, &b);
-  return b;
+  if (!_rxCount[_sock] && fillBuffer() <= 0)
+    return -1;
+  return _rxBuffer[_sock][_rxHead[_sock]];
+}
+
+// Refill the read-ahead buffer: a single burst read from the chip and a
+// single RECV command, however many bytes the sketch then reads one by one
+int EthernetClient::fillBuffer() {
+  // A sketch polling read() for the answer to what it wrote must not wait
+  // on its own request: send it once the flush timeout has passed
+  flushIdle(_sock);
+  int ret = recv(_sock, _rxBuffer[_sock], ETHERNET_CLIENT_RX_BUFFER_SIZE);
+  if (ret > 0) {
+    _rxHead[_sock] = 0;
+    _rxCount[_sock] = ret;
+  }
+  return ret;
+}
+
+// Forget what the last connection on this socket left behind
+void EthernetClient::resetSocket(uint8_t sock) {
+  _rxHead[sock] = 0;
+  _rxCount[sock] = 0;
+  _closing &= ~(1 << sock);
 }
 
 void EthernetClient::flush() {
-  ::flush(_sock);
+  if (_sock != MAX_SOCK_NUM)
+    ::flush(_sock);
+}
+
+int EthernetClient::flushAsync() {
+  if (_sock == MAX_SOCK_NUM)
+    return 1;
+  return ::flushAsync(_sock);
+}
+
+void EthernetClient::setFlushTimeout(uint16_t timeout) {
+  ::setFlushTimeout(timeout);
 }
 
 void EthernetClient::stop() {
+  while (!stopAsync())
+    delay(1);
+}
+
+// Returns 1 once the socket has been released and 0 while the other side
+// still has time to acknowledge the FIN; call again until it returns 1.
+int EthernetClient::stopAsync() {
   if (_sock == MAX_SOCK_NUM)
-    return;
+    return 1;
+
+  uint8_t mask = 1 << _sock;
+  if (!(_closing & mask)) {
+    // send whatever is still buffered
+    ::flush(_sock);
 
-  // attempt to close the connection gracefully (send a FIN to other side)
-  disconnect(_sock);
-  unsigned long start = millis();
+    // attempt to close the connection gracefully (send a FIN to other side)
+    disconnect(_sock);
+    _closeStart[_sock] = millis();
+    _closing |= mask;
+  }
 
   // wait up to a second for the connection to close
-  uint8_t s;
-  do {
-    s = status();
-    if (s == SnSR::CLOSED)
-      break; // exit the loop
-    delay(1);
-  } while (millis() - start < 1000);
+  if (status() != SnSR::CLOSED) {
+    if ((uint16_t)((uint16_t)millis() - _closeStart[_sock]) < 1000)
+      return 0;
 
-  // if it hasn't closed, close it forcefully
-  if (s != SnSR::CLOSED)
+    // if it hasn't closed, close it forcefully
     close(_sock);
+  }
 
   EthernetClass::_server_port[_sock] = 0;
+  resetSocket(_sock);
   _sock = MAX_SOCK_NUM;
+  return 1;
 }
 
 uint8_t EthernetClient::connected() {
   if (_sock == MAX_SOCK_NUM) return 0;
+  flushIdle(_sock);
 
   uint8_t s = status();
   return !(s == SnSR::LISTEN || s == SnSR::CLOSED || s == SnSR::FIN_WAIT ||
@@ -5,6 +5,16 @@
 #include "Client.h"
 #include "IPAddress.h"
 
+#ifndef MAX_SOCK_NUM
+#define MAX_SOCK_NUM 4
+#endif
+
+// Bytes read ahead from the chip per socket, in one SPI burst and one
+// RECV command. Costs MAX_SOCK_NUM times this much RAM.
+#ifndef ETHERNET_CLIENT_RX_BUFFER_SIZE
+#define ETHERNET_CLIENT_RX_BUFFER_SIZE 16
+#endif
+
 class EthernetClient : public Client {
 
 public:
@@ -14,14 +24,23 @@ public:
   uint8_t status();
   virtual int connect(IPAddress ip, uint16_t port);
   virtual int connect(const char *host, uint16_t port);
+  int connectAsync(IPAddress ip, uint16_t port);
+  int connectStatus();
   virtual size_t write(uint8_t);
   virtual size_t write(const uint8_t *buf, size_t size);
+  int availableForWrite();
   virtual int available();
   virtual int read();
   virtual int read(uint8_t *buf, size_t size);
   virtual int peek();
   virtual void flush();
+  // Start sending what was written without waiting for it. Returns 1 once
+  // all of it has gone out, 0 while the chip is still sending; call again
+  // to send what was written since
+  int flushAsync();
   virtual void stop();
+  int stopAsync();
+  static void setFlushTimeout(uint16_t timeout);
   virtual uint8_t connected();
   virtual operator bool();
   virtual bool operator==(const bool value) { return bool() == value; }
@@ -31,12 +50,27 @@ public:
   uint8_t getSocketNumber();
 
   friend class EthernetServer;
+  friend class EthernetUDP;
   
   using Print::write;
 
 private:
   static uint16_t _srcport;
   uint8_t _sock;
+
+  // Read-ahead buffers belong to the socket rather than the object, so
+  // the copies handed out by EthernetServer::available() share them
+  static uint8_t _rxBuffer[MAX_SOCK_NUM][ETHERNET_CLIENT_RX_BUFFER_SIZE];
+  static uint8_t _rxHead[MAX_SOCK_NUM];
+  static uint8_t _rxCount[MAX_SOCK_NUM];
+  int fillBuffer();
+  static void resetSocket(uint8_t sock);
+
+  // Sockets with a FIN sent by stopAsync(), and when it was sent. They
+  // still belong to the client closing them, even once the chip shows them
+  // closed, so they aren't handed out again until stopAsync() is done
+  static uint8_t _closing;
+  static uint16_t _closeStart[MAX_SOCK_NUM];
 };
 
 #endif
@@ -0,0 +1,532 @@
+#include <avr/pgmspace.h>
+#include "utility/w5100.h"
+#include "utility/socket.h"
+#include "Ethernet.h"
+#include "EthernetHttpServer.h"
+
+// Server states
+#define HTTP_IDLE    0
+#define HTTP_PARSING 1
+#define HTTP_SENDING 2
+#define HTTP_SKIP    3
+
+// Request parser states
+#define PARSE_METHOD       0
+#define PARSE_PATH         1
+#define PARSE_VERSION      2
+#define PARSE_HEADER_START 3
+#define PARSE_HEADER_NAME  4
+#define PARSE_HEADER_VALUE 5
+
+// _flags
+#define FLAG_HTTP11     0x01
+#define FLAG_KEEPALIVE  0x02
+#define FLAG_CLOSE      0x04
+#define FLAG_CHUNKED    0x08
+#define FLAG_CHUNK_OPEN 0x10
+#define FLAG_RESPONDED  0x20
+#define FLAG_TOO_LONG   0x40
+#define FLAG_BAD        0x80
+
+// Headers the parser looks at; bit n of _header stands for headerNames[n]
+#define HEADER_CONNECTION 0x01
+#define HEADER_LENGTH     0x02
+
+static const char connectionName[] PROGMEM = "connection";
+static const char contentLengthName[] PROGMEM = "content-length";
+static const char * const headerNames[] = { connectionName, contentLengthName };
+
+// Size of a chunk header, "xxxx\r\n"
+#define CHUNK_HEADER 6
+
+static void toHex(char *buf, uint16_t value) {
+  for (int8_t i = 3; i >= 0; i--) {
+    uint8_t d = value & 0x0F;
+    buf[i] = d < 10 ? '0' + d : 'a' + d - 10;
+    value >>= 4;
+  }
+}
+
+EthernetHttpServer::EthernetHttpServer(uint16_t port) :
+  _server(port), _routes(0), _routeCount(0), _state(HTTP_IDLE), _idle(0) {
+}
+
+void EthernetHttpServer::begin(const HttpRoute *routes, uint8_t count) {
+  _routes = routes;
+  _routeCount = count;
+  _server.begin();
+}
+
+void EthernetHttpServer::poll() {
+  expireIdle();
+
+  switch (_state) {
+    case HTTP_IDLE:
+      // the next connection with a request waiting, new or kept alive
+      _client = _server.available();
+      if (!_client)
+        return;
+      _idle &= ~(1 << _client.getSocketNumber());
+      reset();
+      _state = HTTP_PARSING;
+      _started = millis();
+      // fall through
+
+    case HTTP_PARSING:
+      while (_client.available()) {
+        if (parse(_client.read())) {
+          dispatch();
+          return;
+        }
+      }
+      if (!_client.connected()) {
+        close();
+      }
+      else if (millis() - _started > HTTP_REQUEST_TIMEOUT) {
+        sendError(408);
+      }
+      break;
+
+    case HTTP_SENDING: {
+      int ret = _transfer.poll();
+      if (ret < 0)
+        close();
+      else if (ret > 0)
+        finish();
+      break;
+    }
+
+    case HTTP_SKIP:
+      // throw away the part of the request body the handler didn't read
+      while (_remaining && _client.available()) {
+        _client.read();
+        _remaining--;
+      }
+      if (!_remaining)
+        finish();
+      else if (!_client.connected() || millis() - _started > HTTP_REQUEST_TIMEOUT)
+        close();
+      break;
+  }
+}
+
+int EthernetHttpServer::available() {
+  int n = _client.available();
+  if ((uint16_t)n > _remaining)
+    n = _remaining;
+  return n;
+}
+
+int EthernetHttpServer::read() {
+  if (!_remaining)
+    return -1;
+  int c = _client.read();
+  if (c >= 0)
+    _remaining--;
+  return c;
+}
+
+void EthernetHttpServer::beginResponse(uint16_t status, const char *contentType, int32_t length) {
+  // HTTP/1.0 has no chunked encoding, the end of the connection marks the
+  // end of the body instead
+  if (length < 0 && !(_flags & FLAG_HTTP11))
+    _flags &= ~FLAG_KEEPALIVE;
+
+  sendStatus(status);
+  if (contentType) {
+    writeP(PSTR("Content-Type: "));
+    writeP(contentType);
+    writeP(PSTR("\r\n"));
+  }
+  sendHeaders(length);
+  _flags |= FLAG_RESPONDED;
+}
+
+void EthernetHttpServer::endResponse() {
+  if (!(_flags & FLAG_RESPONDED))
+    return;
+  if (_flags & FLAG_CHUNKED) {
+    closeChunk();
+    writeP(PSTR("0\r\n\r\n"));
+  }
+  _client.flush();
+  finish();
+}
+
+size_t EthernetHttpServer::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t EthernetHttpServer::write(const uint8_t *buf, size_t size) {
+  if (!(_flags & FLAG_CHUNKED))
+    return _client.write(buf, size);
+
+  // Chunked: the body goes into the TX buffer as it is written, and the
+  // size in the current chunk's header is patched for as long as the
+  // header hasn't been sent. Writes are never larger than the free space,
+  // so sendBuffered() can't send a header before it has been patched.
+  SOCKET s = _client.getSocketNumber();
+  size_t n = 0;
+
+  while (n < size) {
+    uint16_t room = sendAvailable(s);
+    uint16_t len = size - n;
+
+    if ((_flags & FLAG_CHUNK_OPEN) &&
+        sendPending(s) >= _chunkLength + CHUNK_HEADER &&
+        sendPointer(s) == (uint16_t)(_chunkPtr + CHUNK_HEADER + _chunkLength)) {
+      // add to the current chunk
+      if (!room) {
+        ::flush(s);
+        continue;
+      }
+      if (len > room)
+        len = room;
+      if (sendBuffered(s, buf + n, len) != len)
+        break;
+      _chunkLength += len;
+
+      char hex[4];
+      toHex(hex, _chunkLength);
+      sendPatch(s, _chunkPtr, (const uint8_t *)hex, sizeof(hex));
+    }
+    else if (_flags & FLAG_CHUNK_OPEN) {
+      // the header has gone out, finish that chunk and start another
+      closeChunk();
+      continue;
+    }
+    else {
+      if (room < CHUNK_HEADER + 1) {
+        if (sendPending(s))
+          ::flush(s);
+        else if (!_client.connected())
+          break;
+        continue;
+      }
+      if (len > room - CHUNK_HEADER)
+        len = room - CHUNK_HEADER;
+
+      char header[CHUNK_HEADER];
+      toHex(header, len);
+      header[4] = '\r';
+      header[5] = '\n';
+      if (sendBuffered(s, (const uint8_t *)header, sizeof(header)) != sizeof(header))
+        break;
+      _chunkPtr = sendPointer(s) - CHUNK_HEADER;
+      if (sendBuffered(s, buf + n, len) != len)
+        break;
+      _chunkLength = len;
+      _flags |= FLAG_CHUNK_OPEN;
+    }
+    n += len;
+  }
+
+  if (n < size)
+    setWriteError();
+  if (!getFlushTimeout())
+    ::flush(s);
+  return n;
+}
+
+void EthernetHttpServer::reset() {
+  _parse = PARSE_METHOD;
+  _method = 0;
+  _length = 0;
+  _query = 0;
+  _header = 0;
+  _index = 0;
+  _flags = 0;
+  _contentLength = 0;
+  _remaining = 0;
+  _path[0] = '\0';
+}
+
+// Feed one byte of the request line and headers to the parser. Returns 1
+// once the blank line after the headers has been seen, or on a bad request
+uint8_t EthernetHttpServer::parse(uint8_t c) {
+  switch (_parse) {
+    case PARSE_METHOD:
+      if (c == '\r' || c == '\n') {
+        // some clients send an extra CRLF after a request body
+        if (!_length)
+          break;
+        _flags |= FLAG_BAD;
+        return 1;
+      }
+      if (c != ' ') {
+        store(c);
+        break;
+      }
+      // the method is kept in the path buffer until we know which it is
+      _path[_length] = '\0';
+      if (!strcmp_P(_path, PSTR("GET")))
+        _method = HTTP_GET;
+      else if (!strcmp_P(_path, PSTR("POST")))
+        _method = HTTP_POST;
+      else
+        _method = HTTP_OTHER;
+      _length = 0;
+      _parse = PARSE_PATH;
+      break;
+
+    case PARSE_PATH:
+      if (c == '\r' || c == '\n') {
+        _flags |= FLAG_BAD;
+        return 1;
+      }
+      if (c == '?' && !_query) {
+        store('\0');
+        _query = _length;
+      }
+      else if (c == ' ') {
+        _path[_length] = '\0';
+        if (!_query)
+          _query = _length;
+        _index = 0;
+        _parse = PARSE_VERSION;
+      }
+      else {
+        store(c);
+      }
+      break;
+
+    case PARSE_VERSION:
+      // "HTTP/1.1"; anything but a 0 after the dot is taken as 1.1
+      if (c == '\n')
+        _parse = PARSE_HEADER_START;
+      else if (_index++ == 7 && c != '0')
+        _flags |= FLAG_HTTP11;
+      break;
+
+    case PARSE_HEADER_START:
+      if (c == '\r')
+        break;
+      if (c == '\n') {
+        // end of the headers
+        if (_flags & FLAG_CLOSE)
+          _flags &= ~FLAG_KEEPALIVE;
+        else if (_flags & FLAG_HTTP11)
+          _flags |= FLAG_KEEPALIVE;
+        _remaining = _contentLength;
+        return 1;
+      }
+      _header = HEADER_CONNECTION | HEADER_LENGTH;
+      _index = 0;
+      _parse = PARSE_HEADER_NAME;
+      // fall through
+
+    case PARSE_HEADER_NAME:
+      if (c == ':') {
+        // keep the header whose whole name matched, if any
+        for (uint8_t i = 0; i < 2; i++) {
+          if (pgm_read_byte(headerNames[i] + _index))
+            _header &= ~(1 << i);
+        }
+        _index = 0;
+        _parse = PARSE_HEADER_VALUE;
+        break;
+      }
+      if (!_header)
+        break;
+      if (c >= 'A' && c <= 'Z')
+        c += 'a' - 'A';
+      for (uint8_t i = 0; i < 2; i++) {
+        if (pgm_read_byte(headerNames[i] + _index) != c)
+          _header &= ~(1 << i);
+      }
+      _index++;
+      break;
+
+    case PARSE_HEADER_VALUE:
+      if (c == '\n') {
+        _parse = PARSE_HEADER_START;
+        break;
+      }
+      if (c == ' ' && !_index)
+        break;
+      if (_header == HEADER_CONNECTION && !_index) {
+        // "keep-alive" or "close"
+        if (c == 'k' || c == 'K')
+          _flags |= FLAG_KEEPALIVE;
+        else if (c == 'c' || c == 'C')
+          _flags |= FLAG_CLOSE;
+      }
+      else if (_header == HEADER_LENGTH && c >= '0' && c <= '9') {
+        _contentLength = _contentLength * 10 + (c - '0');
+      }
+      _index = 1;
+      break;
+  }
+  return 0;
+}
+
+void EthernetHttpServer::store(char c) {
+  if (_length < HTTP_MAX_PATH)
+    _path[_length++] = c;
+  else
+    _flags |= FLAG_TOO_LONG;
+}
+
+// Compare a PROGMEM route path with the request path; a trailing '*'
+// matches whatever is left
+uint8_t EthernetHttpServer::matchPath(const char *path) {
+  for (uint8_t i = 0; ; i++) {
+    char c = pgm_read_byte(path + i);
+    if (c == '*' && !pgm_read_byte(path + i + 1))
+      return 1;
+    if (c != _path[i])
+      return 0;
+    if (!c)
+      return 1;
+  }
+}
+
+void EthernetHttpServer::dispatch() {
+  if (_flags & FLAG_BAD) {
+    sendError(400);
+    return;
+  }
+  if (_flags & FLAG_TOO_LONG) {
+    sendError(414);
+    return;
+  }
+
+  for (uint8_t i = 0; i < _routeCount; i++) {
+    HttpRoute route;
+    memcpy_P(&route, &_routes[i], sizeof(route));
+    if (!(route.method & _method) || !matchPath(route.path))
+      continue;
+
+    if (route.asset) {
+      sendAsset(route.asset);
+      return;
+    }
+    route.handler(*this);
+    // a handler that returns without calling endResponse() has it done
+    // for it, and one that didn't respond at all gets an error
+    if (_state == HTTP_PARSING) {
+      if (_flags & FLAG_RESPONDED)
+        endResponse();
+      else
+        sendError(500);
+    }
+    return;
+  }
+  sendError(404);
+}
+
+void EthernetHttpServer::sendAsset(const HttpAsset *asset) {
+  HttpAsset a;
+  memcpy_P(&a, asset, sizeof(a));
+  writeP(a.headers);
+  sendHeaders(a.length);
+  // the body follows a piece per poll()
+  _transfer.begin_P(_client, a.body, a.length);
+  _state = HTTP_SENDING;
+}
+
+void EthernetHttpServer::sendError(uint16_t status) {
+  // after a bad or unfinished request we can't tell where the next starts
+  if (status != 404)
+    _flags &= ~FLAG_KEEPALIVE;
+  beginResponse(status, 0, 0);
+  endResponse();
+}
+
+void EthernetHttpServer::sendStatus(uint16_t status) {
+  const char *reason;
+  switch (status) {
+    case 200: reason = PSTR("OK"); break;
+    case 400: reason = PSTR("Bad Request"); break;
+    case 404: reason = PSTR("Not Found"); break;
+    case 408: reason = PSTR("Request Timeout"); break;
+    case 414: reason = PSTR("URI Too Long"); break;
+    case 500: reason = PSTR("Internal Server Error"); break;
+    default: reason = PSTR(""); break;
+  }
+  writeP(PSTR("HTTP/1.1 "));
+  _client.print(status);
+  _client.write(' ');
+  writeP(reason);
+  writeP(PSTR("\r\n"));
+}
+
+void EthernetHttpServer::sendHeaders(int32_t length) {
+  if (length >= 0) {
+    writeP(PSTR("Content-Length: "));
+    _client.print(length);
+    writeP(PSTR("\r\n"));
+  }
+  else if (_flags & FLAG_HTTP11) {
+    writeP(PSTR("Transfer-Encoding: chunked\r\n"));
+  }
+
+  if (_flags & FLAG_KEEPALIVE)
+    writeP(PSTR("Connection: keep-alive\r\n\r\n"));
+  else
+    writeP(PSTR("Connection: close\r\n\r\n"));
+
+  if (length < 0 && (_flags & FLAG_HTTP11))
+    _flags |= FLAG_CHUNKED;
+}
+
+void EthernetHttpServer::writeP(const char *str) {
+  uint8_t buf[32];
+  uint8_t len;
+  do {
+    len = 0;
+    while (len < sizeof(buf) && (buf[len] = pgm_read_byte(str + len)))
+      len++;
+    _client.write(buf, len);
+    str += len;
+  } while (len == sizeof(buf));
+}
+
+void EthernetHttpServer::closeChunk() {
+  if (_flags & FLAG_CHUNK_OPEN) {
+    _client.write((const uint8_t *)"\r\n", 2);
+    _flags &= ~FLAG_CHUNK_OPEN;
+  }
+}
+
+// The response is complete: skip what is left of the request body and
+// wait for the next request, or hang up
+void EthernetHttpServer::finish() {
+  if (!(_flags & FLAG_KEEPALIVE)) {
+    close();
+    return;
+  }
+  if (_remaining && _state != HTTP_SKIP) {
+    _state = HTTP_SKIP;
+    _started = millis();
+    return;
+  }
+
+  SOCKET s = _client.getSocketNumber();
+  _idle |= 1 << s;
+  _idleSince[s] = millis();
+  _state = HTTP_IDLE;
+}
+
+void EthernetHttpServer::close() {
+  // EthernetServer finishes closing it if the FIN isn't acknowledged yet
+  _client.stopAsync();
+  _state = HTTP_IDLE;
+}
+
+void EthernetHttpServer::expireIdle() {
+  if (!_idle)
+    return;
+
+  for (uint8_t s = 0; s < MAX_SOCK_NUM; s++) {
+    if (!(_idle & (1 << s)) ||
+        (uint16_t)((uint16_t)millis() - _idleSince[s]) < HTTP_KEEPALIVE_TIMEOUT)
+      continue;
+
+    _idle &= ~(1 << s);
+    // it may have been closed by the other side and reused since
+    EthernetClient client(s);
+    if (client.status() == SnSR::ESTABLISHED)
+      client.stopAsync();
+  }
+}
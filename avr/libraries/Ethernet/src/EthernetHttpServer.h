@@ -0,0 +1,131 @@
+/*
+ * EthernetHttpServer: a small HTTP/1.1 server for status pages and the like.
+ *
+ * Requests are parsed a byte at a time as they arrive, so only the path and
+ * query string are kept in RAM. Routes, and static pages compiled into
+ * flash, are read from PROGMEM. Responses go straight into the chip's TX
+ * buffer, either with a Content-Length or chunked, and connections are kept
+ * alive between requests. Nothing is allocated on the heap.
+ *
+ * Call poll() from loop(); a static page is sent a piece per call.
+ */
+
+#ifndef ethernethttpserver_h
+#define ethernethttpserver_h
+
+#include "EthernetClient.h"
+#include "EthernetServer.h"
+#include "EthernetTransfer.h"
+
+// Longest path plus query string kept; longer requests get a 414
+#ifndef HTTP_MAX_PATH
+#define HTTP_MAX_PATH 32
+#endif
+
+// Idle kept-alive connections are closed after this many ms
+#ifndef HTTP_KEEPALIVE_TIMEOUT
+#define HTTP_KEEPALIVE_TIMEOUT 5000
+#endif
+
+// A request must be complete within this many ms
+#ifndef HTTP_REQUEST_TIMEOUT
+#define HTTP_REQUEST_TIMEOUT 2000
+#endif
+
+// Route methods
+#define HTTP_GET   0x01
+#define HTTP_POST  0x02
+#define HTTP_OTHER 0x80
+#define HTTP_ANY   0xFF
+
+class EthernetHttpServer;
+
+typedef void (*HttpHandler)(EthernetHttpServer &http);
+
+// A static page in PROGMEM. headers holds the status line and any fixed
+// headers, each ending in "\r\n"; Content-Length and Connection are added
+typedef struct {
+  const char *headers;
+  const uint8_t *body;
+  uint16_t length;
+} HttpAsset;
+
+// One entry of the PROGMEM route table. A path ending in '*' matches any
+// path starting with what comes before it. Either handler or asset is set
+typedef struct {
+  uint8_t method;
+  const char *path;
+  HttpHandler handler;
+  const HttpAsset *asset;
+} HttpRoute;
+
+class EthernetHttpServer : public Print {
+public:
+  EthernetHttpServer(uint16_t port = 80);
+
+  // routes and count describe an array of HttpRoute in PROGMEM
+  void begin(const HttpRoute *routes, uint8_t count);
+  void poll();
+
+  // The request being handled
+  uint8_t method() { return _method; };
+  const char *path() { return _path; };
+  const char *query() { return _path + _query; };
+  uint16_t contentLength() { return _contentLength; };
+  // Read the request body, up to contentLength() bytes
+  int available();
+  int read();
+
+  // Start the response. contentType is a PROGMEM string. Without a length
+  // the body is sent chunked (or until the connection closes for HTTP/1.0)
+  void beginResponse(uint16_t status, const char *contentType, int32_t length = -1);
+  void endResponse();
+  virtual size_t write(uint8_t);
+  virtual size_t write(const uint8_t *buf, size_t size);
+  using Print::write;
+
+private:
+  void reset();
+  uint8_t parse(uint8_t c);
+  void store(char c);
+  uint8_t matchPath(const char *path);
+  void dispatch();
+  void sendAsset(const HttpAsset *asset);
+  void sendError(uint16_t status);
+  void sendStatus(uint16_t status);
+  void sendHeaders(int32_t length);
+  void writeP(const char *str);
+  void closeChunk();
+  void finish();
+  void close();
+  void expireIdle();
+
+  EthernetServer _server;
+  EthernetClient _client;
+  EthernetTransfer _transfer;
+  const HttpRoute *_routes;
+  uint8_t _routeCount;
+
+  uint8_t _state;
+  uint8_t _parse;
+  uint8_t _method;
+  uint8_t _length;
+  uint8_t _query;
+  uint8_t _header;
+  uint8_t _index;
+  uint8_t _flags;
+  uint16_t _contentLength;
+  uint16_t _remaining;
+  unsigned long _started;
+  char _path[HTTP_MAX_PATH + 1];
+
+  // Chunk being sent: where its size is written and how long it is so far
+  uint16_t _chunkPtr;
+  uint16_t _chunkLength;
+
+  // Kept-alive connections waiting for their next request
+  uint8_t _idle;
+  uint16_t _idleSince[MAX_SOCK_NUM];
+};
+
+#endif
@@ -17,10 +17,12 @@ void EthernetServer::begin()
 {
   for (int sock = 0; sock < MAX_SOCK_NUM; sock++) {
     EthernetClient client(sock);
-    if (client.status() == SnSR::CLOSED) {
+    if (!(EthernetClient::_closing & (1 << sock)) && client.status() == SnSR::CLOSED) {
       socket(sock, SnMR::TCP, _port, 0);
       listen(sock);
+      EthernetClient::resetSocket(sock);
       EthernetClass::_server_port[sock] = _port;
+      EthernetClass::_state[sock] = client.status();
       break;
     }
   }  
@@ -29,16 +31,31 @@ void EthernetServer::begin()
 void EthernetServer::accept()
 {
   int listening = 0;
+  // Only sockets with events (all of them without interrupts) or still
+  // closing can have changed state; the rest keep the status seen last time
+  uint8_t ready = Ethernet.select() | EthernetClient::_closing;
 
   for (int sock = 0; sock < MAX_SOCK_NUM; sock++) {
     EthernetClient client(sock);
 
     if (EthernetClass::_server_port[sock] == _port) {
-      if (client.status() == SnSR::LISTEN) {
+      flushIdle(sock);
+      if (ready & (1 << sock)) {
+        EthernetClass::_state[sock] = client.status();
+        EthernetClass::_events[sock] &= SnIR::RECV;
+      }
+
+      uint8_t s = EthernetClass::_state[sock];
+      if (s == SnSR::LISTEN) {
         listening = 1;
       } 
-      else if (client.status() == SnSR::CLOSE_WAIT && !client.available()) {
-        client.stop();
+      else if (EthernetClient::_closing & (1 << sock)) {
+        // finish closing a connection dropped on an earlier call
+        client.stopAsync();
+      }
+      else if (s == SnSR::CLOSE_WAIT && !client.available()) {
+        // don't hold up the sketch while the FIN is acknowledged
+        client.stopAsync();
       }
     } 
   }
@@ -51,12 +68,14 @@ void EthernetServer::accept()
 EthernetClient EthernetServer::available()
 {
   accept();
+  uint8_t ready = Ethernet.select();
 
   for (int sock = 0; sock < MAX_SOCK_NUM; sock++) {
     EthernetClient client(sock);
     if (EthernetClass::_server_port[sock] == _port) {
-      uint8_t s = client.status();
-      if (s == SnSR::ESTABLISHED || s == SnSR::CLOSE_WAIT) {
+      uint8_t s = EthernetClass::_state[sock];
+      if ((s == SnSR::ESTABLISHED || s == SnSR::CLOSE_WAIT) &&
+          ((ready & (1 << sock)) || EthernetClient::_rxCount[sock])) {
         if (client.available()) {
           // XXX: don't always pick the lowest numbered socket.
           return client;
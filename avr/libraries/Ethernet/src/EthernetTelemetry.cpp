@@ -0,0 +1,84 @@
+#include "utility/w5100.h"
+#include "utility/socket.h"
+#include "Ethernet.h"
+#include "EthernetTelemetry.h"
+
+EthernetTelemetry::EthernetTelemetry() : _length(0), _records(0) {
+}
+
+uint8_t EthernetTelemetry::begin(IPAddress ip, uint16_t port, uint16_t localPort,
+                                 uint16_t mtu, uint16_t maxAge) {
+  if (!EthernetUDP::begin(localPort))
+    return 0;
+  if (!startUDP(_sock, rawIPAddress(ip), port)) {
+    stop();
+    return 0;
+  }
+
+  // a batch has to fit in the TX buffer in one go
+  uint16_t size = W5100.getTXBufferSize(_sock);
+  _mtu = mtu < size ? mtu : size;
+  _maxAge = maxAge;
+  _length = 0;
+  _records = 0;
+  return 1;
+}
+
+int EthernetTelemetry::add(const void *record, uint16_t length) {
+  EthernetTelemetryField field = { record, length };
+  return add(&field, 1);
+}
+
+int EthernetTelemetry::add(const EthernetTelemetryField *fields, uint8_t count) {
+  if (_sock == MAX_SOCK_NUM)
+    return 0;
+
+  uint16_t length = 0;
+  for (uint8_t i = 0; i < count; i++)
+    length += fields[i].length;
+  if (length > _mtu)
+    return 0;
+  if (_length && _length + length > _limit && !send())
+    return 0;
+
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  if (!_length) {
+    // A send that timed out can leave data in the TX buffer, so the batch
+    // is held to the space that is free now, read along with the write
+    // pointer once per batch
+    uint16_t free = W5100.getTXFreeSize(_sock);
+    _ptr = W5100.readSnTX_WR(_sock);
+    _limit = free < _mtu ? free : _mtu;
+    _started = millis();
+  }
+  if (_length + length > _limit) {
+    SPI.endTransaction();
+    return 0;
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    W5100.write_data(_sock, _ptr + _length, (const uint8_t *)fields[i].data, fields[i].length);
+    _length += fields[i].length;
+  }
+  SPI.endTransaction();
+
+  _records++;
+  return 1;
+}
+
+int EthernetTelemetry::poll() {
+  if (_length && millis() - _started >= _maxAge)
+    return send();
+  return 1;
+}
+
+int EthernetTelemetry::send() {
+  if (!_length)
+    return 1;
+
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  W5100.writeSnTX_WR(_sock, _ptr + _length);
+  SPI.endTransaction();
+  _length = 0;
+  _records = 0;
+  return sendUDP(_sock);
+}
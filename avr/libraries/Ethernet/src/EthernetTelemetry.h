@@ -0,0 +1,72 @@
+/*
+ * EthernetTelemetry: pack many small records into one UDP datagram.
+ *
+ * Records are written straight into the socket's TX buffer, each from one
+ * or more pieces (say a header, a payload and a CRC) in a single SPI
+ * transaction, and the TX pointer is kept in RAM in between. The batch is
+ * sent when the next record would make it larger than the MTU, once the
+ * oldest record in it is maxAge ms old, or when send() is called. A
+ * collector then handles one packet for many records.
+ *
+ * Don't mix add() with beginPacket()/write() on the same object; receiving
+ * with parsePacket() is fine.
+ */
+
+#ifndef ethernettelemetry_h
+#define ethernettelemetry_h
+
+#include "EthernetUdp.h"
+
+// Largest datagram payload; 1472 fills a 1500 byte Ethernet frame
+#ifndef ETHERNET_TELEMETRY_MTU
+#define ETHERNET_TELEMETRY_MTU 1472
+#endif
+
+// Milliseconds the first record of a batch may wait for company
+#ifndef ETHERNET_TELEMETRY_AGE
+#define ETHERNET_TELEMETRY_AGE 1000
+#endif
+
+// One piece of a record
+typedef struct {
+  const void *data;
+  uint16_t length;
+} EthernetTelemetryField;
+
+class EthernetTelemetry : public EthernetUDP {
+public:
+  EthernetTelemetry();
+
+  // Open a socket on localPort (0 picks one) and send batches to ip:port.
+  // The MTU is reduced to the socket's TX buffer size if need be.
+  uint8_t begin(IPAddress ip, uint16_t port, uint16_t localPort = 0,
+                uint16_t mtu = ETHERNET_TELEMETRY_MTU,
+                uint16_t maxAge = ETHERNET_TELEMETRY_AGE);
+  using EthernetUDP::begin;
+
+  // Add a record made of count pieces, written in order. Returns 1 if it
+  // was added, 0 if it is larger than the MTU, a full batch couldn't be
+  // sent to make room or the TX buffer still holds too much unsent data
+  int add(const EthernetTelemetryField *fields, uint8_t count);
+  int add(const void *record, uint16_t length);
+
+  // Send the batch if its first record has waited maxAge ms. Returns 0 if
+  // that failed, 1 otherwise
+  int poll();
+  // Send the batch now. Returns 1 if it was sent (or empty), 0 on error
+  int send();
+
+  uint16_t pending() { return _length; };
+  uint8_t records() { return _records; };
+
+private:
+  uint16_t _mtu;
+  uint16_t _limit;    // size the batch can grow to
+  uint16_t _maxAge;
+  uint16_t _ptr;      // TX pointer the batch starts at
+  uint16_t _length;   // bytes in the batch
+  uint8_t _records;
+  unsigned long _started;
+};
+
+#endif
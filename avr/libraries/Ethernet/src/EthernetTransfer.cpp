@@ -0,0 +1,88 @@
+#include <avr/pgmspace.h>
+#include "EthernetTransfer.h"
+
+#define TRANSFER_STREAM  0
+#define TRANSFER_READER  1
+#define TRANSFER_PROGMEM 2
+
+EthernetTransfer::EthernetTransfer() : _remaining(0) {
+}
+
+void EthernetTransfer::begin(const EthernetClient &client, Stream &source, uint32_t length) {
+  _client = client;
+  _source = TRANSFER_STREAM;
+  _from.stream = &source;
+  _offset = 0;
+  _remaining = length;
+}
+
+void EthernetTransfer::begin(const EthernetClient &client, EthernetTransferReader reader, uint32_t offset, uint32_t length) {
+  _client = client;
+  _source = TRANSFER_READER;
+  _from.reader = reader;
+  _offset = offset;
+  _remaining = length;
+}
+
+void EthernetTransfer::begin_P(const EthernetClient &client, const uint8_t *data, uint32_t length) {
+  _client = client;
+  _source = TRANSFER_PROGMEM;
+  _from.progmem = data;
+  _offset = 0;
+  _remaining = length;
+}
+
+int EthernetTransfer::poll() {
+  // done once the last of it has gone out too
+  if (!_remaining)
+    return _client.flushAsync();
+  if (!_client.connected())
+    return -1;
+
+  uint16_t room = _client.availableForWrite();
+  if (!room) {
+    // send what the last poll() wrote once the SEND before it is done
+    _client.flushAsync();
+    return 0;
+  }
+
+  while (room && _remaining) {
+    uint8_t buf[ETHERNET_TRANSFER_CHUNK];
+    uint16_t len = sizeof(buf);
+    if (len > room)
+      len = room;
+    if (len > _remaining)
+      len = _remaining;
+
+    len = read(buf, len);
+    if (!len) {
+      // the source ran out early; send what we have
+      _remaining = 0;
+      break;
+    }
+    if (_client.write(buf, len) != len)
+      return -1;
+
+    _offset += len;
+    _remaining -= len;
+    room -= len;
+  }
+
+  // The TX buffer is full or we're done: send it now rather than wait
+  // for the flush timeout, and see it through on the next poll()
+  if (!_client.flushAsync() || _remaining)
+    return 0;
+  return 1;
+}
+
+uint16_t EthernetTransfer::read(uint8_t *buf, uint16_t len) {
+  switch (_source) {
+    case TRANSFER_STREAM:
+      return _from.stream->readBytes((char *)buf, len);
+    case TRANSFER_READER:
+      return _from.reader(_offset, buf, len);
+    default:
+      memcpy_P(buf, _from.progmem + _offset, len);
+      return len;
+  }
+}
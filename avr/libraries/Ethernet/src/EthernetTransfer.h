@@ -0,0 +1,52 @@
+/*
+ * EthernetTransfer: send a file, a dataflash range or a PROGMEM array over an
+ * EthernetClient a little at a time, so that a large download doesn't hold up
+ * loop(). Data is moved in ETHERNET_TRANSFER_CHUNK sized bursts and only as
+ * fast as the socket's TX buffer has room for it.
+ */
+
+#ifndef ethernettransfer_h
+#define ethernettransfer_h
+
+#include "EthernetClient.h"
+
+// Bytes staged in RAM between the source and the chip per burst
+#ifndef ETHERNET_TRANSFER_CHUNK
+#define ETHERNET_TRANSFER_CHUNK 32
+#endif
+
+// Fills buf with len bytes starting at offset; returns the number of bytes read
+typedef uint16_t (*EthernetTransferReader)(uint32_t offset, uint8_t *buf, uint16_t len);
+
+class EthernetTransfer {
+public:
+  EthernetTransfer();
+
+  // Send length bytes read from a Stream, such as an SD File
+  void begin(const EthernetClient &client, Stream &source, uint32_t length);
+  // Send length bytes from offset, fetched through a reader function
+  void begin(const EthernetClient &client, EthernetTransferReader reader, uint32_t offset, uint32_t length);
+  // Send length bytes from an array in PROGMEM
+  void begin_P(const EthernetClient &client, const uint8_t *data, uint32_t length);
+
+  // Move as much data as the TX buffer has room for. Returns 1 once
+  // everything has been sent, 0 while there is more to do and -1 if the
+  // connection was lost
+  int poll();
+  uint32_t remaining() { return _remaining; };
+
+private:
+  uint16_t read(uint8_t *buf, uint16_t len);
+
+  EthernetClient _client;
+  uint8_t _source;
+  union {
+    Stream *stream;
+    EthernetTransferReader reader;
+    const uint8_t *progmem;
+  } _from;
+  uint32_t _offset;
+  uint32_t _remaining;
+};
+
+#endif
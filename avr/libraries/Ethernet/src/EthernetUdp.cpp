@@ -41,6 +41,8 @@ uint8_t EthernetUDP::begin(uint16_t port) {
     return 0;
 
   for (int i = 0; i < MAX_SOCK_NUM; i++) {
+    if (EthernetClient::_closing & (1 << i))
+      continue;
     uint8_t s = socketStatus(i);
     if (s == SnSR::CLOSED || s == SnSR::FIN_WAIT) {
       _sock = i;
@@ -221,6 +223,8 @@ uint8_t EthernetUDP::beginMulticast(IPAddress ip, uint16_t port)
     return 0;
 
   for (int i = 0; i < MAX_SOCK_NUM; i++) {
+    if (EthernetClient::_closing & (1 << i))
+      continue;
     uint8_t s = W5100.readSnSR(i);
     if (s == SnSR::CLOSED || s == SnSR::FIN_WAIT) {
       _sock = i;
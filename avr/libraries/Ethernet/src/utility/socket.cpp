@@ -3,6 +3,41 @@
 
 static uint16_t local_port;
 
+// Data written to a TCP socket's TX buffer but not yet sent. TX_WR is read
+// once when a segment is started and written back once by flush(); the
+// free size is likewise read once and counted down as data is added.
+static uint16_t tx_pending[MAX_SOCK_NUM];
+static uint16_t tx_ptr[MAX_SOCK_NUM];
+static uint16_t tx_free[MAX_SOCK_NUM];
+static unsigned long tx_time[MAX_SOCK_NUM];
+// Sockets with a SEND issued by flushAsync() and not yet seen through
+static uint8_t tx_sending;
+static uint16_t tx_timeout = ETHERNET_FLUSH_TIMEOUT;
+
+/**
+ * @brief	Check on a SEND issued by flushAsync().
+ * @return	1 if there is none or it has finished, 0 while it is going on.
+ */
+static uint8_t sendDone(SOCKET s)
+{
+  if (!(tx_sending & (1 << s)))
+    return 1;
+
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  if (!(W5100.readSnIR(s) & SnIR::SEND_OK)) {
+    uint8_t status = W5100.readSnSR(s);
+    SPI.endTransaction();
+    if (status != SnSR::CLOSED)
+      return 0;
+    close(s);
+    return 1;
+  }
+  W5100.writeSnIR(s, SnIR::SEND_OK);
+  SPI.endTransaction();
+  tx_sending &= ~(1 << s);
+  return 1;
+}
+
 /**
  * @brief	This Socket function initialize the channel in perticular mode, and set the port and wait for W5100 done it.
  * @return 	1 for success else 0.
@@ -45,6 +80,8 @@ uint8_t socketStatus(SOCKET s)
  */
 void close(SOCKET s)
 {
+  tx_pending[s] = 0;
+  tx_sending &= ~(1 << s);
   SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
   W5100.execCmdSn(s, Sock_CLOSE);
   W5100.writeSnIR(s, 0xFF);
@@ -119,11 +156,15 @@ uint16_t send(SOCKET s, const uint8_t * buf, uint16_t len)
   uint16_t ret=0;
   uint16_t freesize=0;
 
-  if (len > W5100.SSIZE) 
-    ret = W5100.SSIZE; // check size not to exceed MAX size.
+  if (len > W5100.getTXBufferSize(s)) 
+    ret = W5100.getTXBufferSize(s); // check size not to exceed MAX size.
   else 
     ret = len;
 
+  // a SEND left going by flushAsync() would look like ours finishing
+  while (!sendDone(s))
+    yield();
+
   // if freebuf is available, start.
   do 
   {
@@ -240,7 +281,7 @@ uint16_t sendto(SOCKET s, const uint8_t *buf, uint16_t len, uint8_t *addr, uint1
 {
   uint16_t ret=0;
 
-  if (len > W5100.SSIZE) ret = W5100.SSIZE; // check size not to exceed MAX size.
+  if (len > W5100.getTXBufferSize(s)) ret = W5100.getTXBufferSize(s); // check size not to exceed MAX size.
   else ret = len;
 
   if
@@ -360,18 +401,183 @@ uint16_t recvfrom(SOCKET s, uint8_t *buf, uint16_t len, uint8_t *addr, uint16_t
 }
 
 /**
- * @brief	Wait for buffered transmission to complete.
+ * @brief	This function adds data to the socket's TX buffer without sending it. When the
+ * 		buffer is full the data gathered so far is sent to make room.
+ * @return	number of bytes buffered, 0 if the connection is gone.
+ */
+uint16_t sendBuffered(SOCKET s, const uint8_t * buf, uint16_t len)
+{
+  uint16_t ret = 0;
+
+  while (ret < len)
+  {
+    if (tx_pending[s] == 0)
+    {
+      // start a new segment
+      uint8_t status;
+      SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+      status = W5100.readSnSR(s);
+      tx_free[s] = W5100.getTXFreeSize(s);
+      tx_ptr[s] = W5100.readSnTX_WR(s);
+      SPI.endTransaction();
+      if ((status != SnSR::ESTABLISHED) && (status != SnSR::CLOSE_WAIT))
+        break;
+      if (tx_free[s] == 0)
+      {
+        yield();
+        continue;
+      }
+    }
+    else if (tx_free[s] == 0)
+    {
+      // buffer full, send what we have
+      flush(s);
+      continue;
+    }
+
+    uint16_t size = len - ret;
+    if (size > tx_free[s])
+      size = tx_free[s];
+
+    SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+    W5100.write_data(s, tx_ptr[s], buf + ret, size);
+    SPI.endTransaction();
+
+    tx_ptr[s] += size;
+    tx_pending[s] += size;
+    tx_free[s] -= size;
+    ret += size;
+  }
+
+  tx_time[s] = millis();
+  return ret;
+}
+
+/**
+ * @brief	This function returns how much sendBuffered() can take without having to wait.
+ */
+uint16_t sendAvailable(SOCKET s)
+{
+  if (tx_pending[s])
+    return tx_free[s];
+
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  uint16_t freesize = W5100.getTXFreeSize(s);
+  SPI.endTransaction();
+  return freesize;
+}
+
+/**
+ * @brief	Number of bytes gathered by sendBuffered() and not sent yet.
+ */
+uint16_t sendPending(SOCKET s)
+{
+  return tx_pending[s];
+}
+
+/**
+ * @brief	TX pointer the next byte given to sendBuffered() will be written at.
+ * 		Only meaningful while sendPending() is not 0.
+ */
+uint16_t sendPointer(SOCKET s)
+{
+  return tx_ptr[s];
+}
+
+/**
+ * @brief	Overwrite data already given to sendBuffered(), as long as it hasn't been sent.
+ * @return	1 for success, 0 if the data at ptr has gone out already.
+ */
+uint8_t sendPatch(SOCKET s, uint16_t ptr, const uint8_t * buf, uint16_t len)
+{
+  // bytes between ptr and the end of the pending data
+  uint16_t ahead = tx_ptr[s] - ptr;
+  if (ahead > tx_pending[s] || len > ahead)
+    return 0;
+
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  W5100.write_data(s, ptr, buf, len);
+  SPI.endTransaction();
+  return 1;
+}
+
+/**
+ * @brief	Send the data gathered by sendBuffered() without waiting for the chip to
+ * 		transmit it. Call again until it returns 1.
+ * @return	1 once everything has been sent, 0 while a SEND is still going on.
+ */
+uint8_t flushAsync(SOCKET s)
+{
+  // the chip takes one SEND at a time
+  if (!sendDone(s))
+    return 0;
+  if (tx_pending[s] == 0)
+    return 1;
+  tx_pending[s] = 0;
+
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  W5100.writeSnTX_WR(s, tx_ptr[s]);
+  W5100.execCmdSn(s, Sock_SEND);
+  SPI.endTransaction();
+  tx_sending |= 1 << s;
+  return 0;
+}
+
+/**
+ * @brief	Send the data gathered by sendBuffered() and wait for the chip to transmit it.
  */
 void flush(SOCKET s) {
-  // TODO
+  while (!sendDone(s))
+    yield();
+  if (tx_pending[s] == 0)
+    return;
+  tx_pending[s] = 0;
+
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  W5100.writeSnTX_WR(s, tx_ptr[s]);
+  W5100.execCmdSn(s, Sock_SEND);
+
+  while ( (W5100.readSnIR(s) & SnIR::SEND_OK) != SnIR::SEND_OK ) 
+  {
+    if ( W5100.readSnSR(s) == SnSR::CLOSED )
+    {
+      SPI.endTransaction();
+      close(s);
+      return;
+    }
+    SPI.endTransaction();
+    yield();
+    SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  }
+  W5100.writeSnIR(s, SnIR::SEND_OK);
+  SPI.endTransaction();
+}
+
+/**
+ * @brief	Flush the socket if nothing has been added to its TX buffer for the flush timeout.
+ */
+void flushIdle(SOCKET s)
+{
+  if (tx_pending[s] && (millis() - tx_time[s]) >= tx_timeout)
+    flush(s);
+}
+
+void setFlushTimeout(uint16_t timeout)
+{
+  tx_timeout = timeout;
+}
+
+uint16_t getFlushTimeout()
+{
+  return tx_timeout;
 }
 
 uint16_t igmpsend(SOCKET s, const uint8_t * buf, uint16_t len)
 {
   uint16_t ret=0;
 
-  if (len > W5100.SSIZE) 
-    ret = W5100.SSIZE; // check size not to exceed MAX size.
+  if (len > W5100.getTXBufferSize(s)) 
+    ret = W5100.getTXBufferSize(s); // check size not to exceed MAX size.
   else 
     ret = len;
 
@@ -3,6 +3,12 @@
 
 #include "utility/w5100.h"
 
+// Milliseconds a partly filled TCP segment may wait for more data before
+// it is sent; 0 sends every write straight away
+#ifndef ETHERNET_FLUSH_TIMEOUT
+#define ETHERNET_FLUSH_TIMEOUT 20
+#endif
+
 extern uint8_t socket(SOCKET s, uint8_t protocol, uint16_t port, uint8_t flag); // Opens a socket(TCP or UDP or IP_RAW mode)
 extern uint8_t socketStatus(SOCKET s);
 extern void close(SOCKET s); // Close socket
@@ -15,7 +21,16 @@ extern int16_t recvAvailable(SOCKET s);
 extern uint16_t peek(SOCKET s, uint8_t *buf);
 extern uint16_t sendto(SOCKET s, const uint8_t * buf, uint16_t len, uint8_t * addr, uint16_t port); // Send data (UDP/IP RAW)
 extern uint16_t recvfrom(SOCKET s, uint8_t * buf, uint16_t len, uint8_t * addr, uint16_t *port); // Receive data (UDP/IP RAW)
-extern void flush(SOCKET s); // Wait for transmission to complete
+extern uint16_t sendBuffered(SOCKET s, const uint8_t * buf, uint16_t len); // Add data to the TX buffer (TCP)
+extern uint16_t sendAvailable(SOCKET s); // Room left in the TX buffer
+extern uint16_t sendPending(SOCKET s); // Bytes buffered but not sent
+extern uint16_t sendPointer(SOCKET s); // Where the next buffered byte goes
+extern uint8_t sendPatch(SOCKET s, uint16_t ptr, const uint8_t * buf, uint16_t len); // Overwrite unsent data
+extern void flush(SOCKET s); // Send buffered data and wait for transmission to complete
+extern uint8_t flushAsync(SOCKET s); // Send buffered data; returns 1 once transmission is complete
+extern void flushIdle(SOCKET s); // Flush if the flush timeout has passed since the last write
+extern void setFlushTimeout(uint16_t timeout);
+extern uint16_t getFlushTimeout();
 
 extern uint16_t igmpsend(SOCKET s, const uint8_t * buf, uint16_t len);
 
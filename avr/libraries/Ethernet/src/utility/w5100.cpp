@@ -15,36 +15,214 @@
 // W5100 controller instance
 W5100Class W5100;
 
-#define TX_RX_MAX_BUF_SIZE 2048
-#define TX_BUF 0x1100
-#define RX_BUF (TX_BUF + TX_RX_MAX_BUF_SIZE)
+uint8_t  W5100Class::chip = 0;
+uint16_t W5100Class::CH_BASE = 0x0400;
+uint8_t  W5100Class::txKB[MAX_SOCK_NUM];
+uint8_t  W5100Class::rxKB[MAX_SOCK_NUM];
+uint8_t  W5100Class::txAsked[MAX_SOCK_NUM];
+uint8_t  W5100Class::rxAsked[MAX_SOCK_NUM];
+uint8_t  W5100Class::asked = 0;
 
-#define TXBUF_BASE 0x4000
-#define RXBUF_BASE 0x6000
-
-void W5100Class::init(void)
+uint8_t W5100Class::init(void)
 {
   delay(300);
 
-#if !defined(SPI_HAS_EXTENDED_CS_PIN_HANDLING)
   SPI.begin();
   initSS();
-#else
-  SPI.begin(ETHERNET_SHIELD_SPI_CS);
-  // Set clock to 4Mhz (W5100 should support up to about 14Mhz)
-  SPI.setClockDivider(ETHERNET_SHIELD_SPI_CS, 21);
-  SPI.setDataMode(ETHERNET_SHIELD_SPI_CS, SPI_MODE0);
-#endif
+  resetSS();
+
+  // Each probe starts with a soft reset. The W5200 does not come back
+  // cleanly from a reset issued with W5100 framing, so it goes first
+  uint8_t ok = 0;
   SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
-  writeMR(1<<RST);
-  writeTMSR(0x55);
-  writeRMSR(0x55);
+  if (isW5200()) {
+    CH_BASE = 0x4000;
+  } else if (isW5500()) {
+    // Not a real address: readSn()/writeSn() map it onto the socket blocks
+    CH_BASE = 0x1000;
+  } else if (isW5100()) {
+    CH_BASE = 0x0400;
+  } else {
+    chip = 0;
+  }
+  if (chip)
+    ok = setBufferSizes();
   SPI.endTransaction();
 
+  // Each socket's buffers follow the previous socket's in chip memory
+  uint16_t txBase = (chip == 51) ? 0x4000 : 0x8000;
+  uint16_t rxBase = (chip == 51) ? 0x6000 : 0xC000;
+  for (int i=0; i<MAX_SOCK_NUM; i++) {
+    SBASE[i] = txBase;
+    RBASE[i] = rxBase;
+    txBase += getTXBufferSize(i);
+    rxBase += getRXBufferSize(i);
+  }
+
+  return ok;
+}
+
+// Fill in kb[] with the sizes asked for, and split what they leave between
+// the sockets that weren't asked for. Returns 0 if it doesn't fit the chip
+static uint8_t layout(uint8_t chip, uint8_t asked, const uint8_t *ask, uint8_t *kb)
+{
+  uint8_t total = (chip == 51) ? 8 : 16;
+  uint8_t used = 0, unset = 0;
+
+  for (int i=0; i<MAX_SOCK_NUM; i++) {
+    if (asked & (1 << i)) {
+      // 0 or a power of two that fits in the chip
+      if (ask[i] > total || (ask[i] & (ask[i] - 1)))
+        return 0;
+      kb[i] = ask[i];
+      used += ask[i];
+    } else {
+      unset++;
+    }
+  }
+  if (used > total)
+    return 0;
+
+  // Each one gets the largest power of two in its share of what's left,
+  // and at least 1 KB while there is any, so the later ones pick up what
+  // the rounding leaves
   for (int i=0; i<MAX_SOCK_NUM; i++) {
-    SBASE[i] = TXBUF_BASE + SSIZE * i;
-    RBASE[i] = RXBUF_BASE + RSIZE * i;
+    if (asked & (1 << i))
+      continue;
+    uint8_t share = (total - used) / unset--;
+    uint8_t size = total;
+    if (share == 0 && used < total)
+      share = 1;
+    while (size > share)
+      size >>= 1;
+    kb[i] = size;
+    used += size;
+  }
+
+  if (chip == 51) {
+    // TMSR/RMSR can't say 0 KB: a W5100 socket takes at least 1 KB until
+    // the sockets before it have used up the memory, and only then none
+    uint8_t placed = 0;
+    for (int i=0; i<MAX_SOCK_NUM; i++) {
+      if (kb[i] == 0 && placed < total)
+        return 0;
+      placed += kb[i];
+    }
+  }
+  return 1;
+}
+
+uint8_t W5100Class::setBufferSize(SOCKET s, uint8_t tx, uint8_t rx)
+{
+  uint8_t tx0, rx0, asked0 = asked;
+  uint8_t kb[MAX_SOCK_NUM];
+
+  if (s >= MAX_SOCK_NUM)
+    return 0;
+  tx0 = txAsked[s];
+  rx0 = rxAsked[s];
+  txAsked[s] = tx;
+  rxAsked[s] = rx;
+  asked |= 1 << s;
+
+  // Before init() the chip isn't known yet: check against the largest
+  // memory, and leave the rest to init()
+  uint8_t c = chip ? chip : 55;
+  if (layout(c, asked, txAsked, kb) && layout(c, asked, rxAsked, kb))
+    return 1;
+
+  txAsked[s] = tx0;
+  rxAsked[s] = rx0;
+  asked = asked0;
+  return 0;
+}
+
+// Program the socket memory layout asked for with setBufferSize(), with
+// the sockets left unset sharing what remains
+uint8_t W5100Class::setBufferSizes()
+{
+  uint8_t tx[MAX_SOCK_NUM], rx[MAX_SOCK_NUM];
+
+  if (!layout(chip, asked, txAsked, tx) || !layout(chip, asked, rxAsked, rx))
+    return 0;
+  memcpy(txKB, tx, MAX_SOCK_NUM);
+  memcpy(rxKB, rx, MAX_SOCK_NUM);
+
+  if (chip == 51) {
+    // Two bits per socket in TMSR/RMSR: 1, 2, 4 or 8 KB, and a socket
+    // at 0 KB comes after the memory has run out. Sockets past
+    // MAX_SOCK_NUM are left at 1 KB and get whatever memory is left
+    uint8_t tmsr = 0, rmsr = 0;
+    for (int i=0; i<MAX_SOCK_NUM; i++) {
+      uint8_t t = 0, r = 0;
+      while ((1 << t) < txKB[i]) t++;
+      while ((1 << r) < rxKB[i]) r++;
+      tmsr |= t << (2 * i);
+      rmsr |= r << (2 * i);
+    }
+    writeTMSR(tmsr);
+    writeRMSR(rmsr);
+  } else {
+    // The W5200 and W5500 have 8 sockets; the ones we don't use get nothing
+    for (SOCKET s=0; s<8; s++) {
+      writeSnTXBUF_SIZE(s, s < MAX_SOCK_NUM ? txKB[s] : 0);
+      writeSnRXBUF_SIZE(s, s < MAX_SOCK_NUM ? rxKB[s] : 0);
+    }
   }
+  return 1;
+}
+
+uint8_t W5100Class::softReset(void)
+{
+  uint8_t count = 0;
+
+  writeMR(1<<RST);
+  // The reset bit clears itself once the chip is ready
+  do {
+    if (readMR() == 0)
+      return 1;
+    delay(1);
+  } while (++count < 20);
+  return 0;
+}
+
+uint8_t W5100Class::isW5100(void)
+{
+  chip = 51;
+  if (!softReset()) return 0;
+  writeMR(0x10);
+  if (readMR() != 0x10) return 0;
+  writeMR(0x12);
+  if (readMR() != 0x12) return 0;
+  writeMR(0x00);
+  if (readMR() != 0x00) return 0;
+  return 1;
+}
+
+uint8_t W5100Class::isW5200(void)
+{
+  chip = 52;
+  if (!softReset()) return 0;
+  writeMR(0x08);
+  if (readMR() != 0x08) return 0;
+  writeMR(0x10);
+  if (readMR() != 0x10) return 0;
+  writeMR(0x00);
+  if (readMR() != 0x00) return 0;
+  return readVERSIONR_W5200() == 3;
+}
+
+uint8_t W5100Class::isW5500(void)
+{
+  chip = 55;
+  if (!softReset()) return 0;
+  writeMR(0x08);
+  if (readMR() != 0x08) return 0;
+  writeMR(0x10);
+  if (readMR() != 0x10) return 0;
+  writeMR(0x00);
+  if (readMR() != 0x00) return 0;
+  return readVERSIONR_W5500() == 4;
 }
 
 uint16_t W5100Class::getTXFreeSize(SOCKET s)
@@ -59,6 +237,36 @@ uint16_t W5100Class::getTXFreeSize(SOCKET s)
   return val;
 }
 
+void W5100Class::enableSocketInterrupts()
+{
+  uint8_t mask = (1 << MAX_SOCK_NUM) - 1;
+
+  if (chip == 51) {
+    // No per-socket mask: every Sn_IR source is enabled
+    writeIMR(mask);
+    return;
+  }
+
+  for (SOCKET s = 0; s < MAX_SOCK_NUM; s++)
+    writeSnIMR(s, SnIR::RECV | SnIR::DISCON | SnIR::CON | SnIR::TIMEOUT);
+  if (chip == 52)
+    writeIMR_W5200(mask);
+  else
+    writeSIMR_W5500(mask);
+}
+
+uint8_t W5100Class::readSocketInterrupts()
+{
+  uint8_t ir;
+  if (chip == 51)
+    ir = readIR();
+  else if (chip == 52)
+    ir = readIR2_W5200();
+  else
+    ir = readSIR_W5500();
+  return ir & ((1 << MAX_SOCK_NUM) - 1);
+}
+
 uint16_t W5100Class::getRXReceivedSize(SOCKET s)
 {
   uint16_t val=0,val1=0;
@@ -82,22 +290,35 @@ void W5100Class::send_data_processing_offset(SOCKET s, uint16_t data_offset, con
 {
   uint16_t ptr = readSnTX_WR(s);
   ptr += data_offset;
-  uint16_t offset = ptr & SMASK;
+  write_data(s, ptr, data, len);
+
+  ptr += len;
+  writeSnTX_WR(s, ptr);
+}
+
+void W5100Class::write_data(SOCKET s, uint16_t ptr, const uint8_t *src, uint16_t len)
+{
+  if (chip == 55)
+  {
+    // The W5500 wraps around the socket's TX block by itself
+    spiWrite(ptr, (s << 5) | 0x10, src, len);
+    return;
+  }
+
+  uint16_t ssize = getTXBufferSize(s);
+  uint16_t offset = ptr & (ssize - 1);
   uint16_t dstAddr = offset + SBASE[s];
 
-  if (offset + len > SSIZE) 
+  if (offset + len > ssize) 
   {
     // Wrap around circular buffer
-    uint16_t size = SSIZE - offset;
-    write(dstAddr, data, size);
-    write(SBASE[s], data + size, len - size);
+    uint16_t size = ssize - offset;
+    spiWrite(dstAddr, 0, src, size);
+    spiWrite(SBASE[s], 0, src + size, len - size);
   } 
   else {
-    write(dstAddr, data, len);
+    spiWrite(dstAddr, 0, src, len);
   }
-
-  ptr += len;
-  writeSnTX_WR(s, ptr);
 }
 
 
@@ -119,100 +340,130 @@ void W5100Class::read_data(SOCKET s, volatile uint16_t src, volatile uint8_t *ds
   uint16_t src_mask;
   uint16_t src_ptr;
 
-  src_mask = src & RMASK;
+  if (chip == 55)
+  {
+    // The W5500 wraps around the socket's RX block by itself
+    spiRead(src, (s << 5) | 0x18, (uint8_t *)dst, len);
+    return;
+  }
+
+  uint16_t rsize = getRXBufferSize(s);
+  src_mask = src & (rsize - 1);
   src_ptr = RBASE[s] + src_mask;
 
-  if( (src_mask + len) > RSIZE ) 
+  if( (src_mask + len) > rsize ) 
   {
-    size = RSIZE - src_mask;
-    read(src_ptr, (uint8_t *)dst, size);
+    size = rsize - src_mask;
+    spiRead(src_ptr, 0, (uint8_t *)dst, size);
     dst += size;
-    read(RBASE[s], (uint8_t *) dst, len - size);
+    spiRead(RBASE[s], 0, (uint8_t *) dst, len - size);
   } 
   else
-    read(src_ptr, (uint8_t *) dst, len);
+    spiRead(src_ptr, 0, (uint8_t *) dst, len);
 }
 
 
 uint8_t W5100Class::write(uint16_t _addr, uint8_t _data)
 {
-#if !defined(SPI_HAS_EXTENDED_CS_PIN_HANDLING)
-  setSS();  
-  SPI.transfer(0xF0);
-  SPI.transfer(_addr >> 8);
-  SPI.transfer(_addr & 0xFF);
-  SPI.transfer(_data);
-  resetSS();
-#else
-  SPI.transfer(ETHERNET_SHIELD_SPI_CS, 0xF0, SPI_CONTINUE);
-  SPI.transfer(ETHERNET_SHIELD_SPI_CS, _addr >> 8, SPI_CONTINUE);
-  SPI.transfer(ETHERNET_SHIELD_SPI_CS, _addr & 0xFF, SPI_CONTINUE);
-  SPI.transfer(ETHERNET_SHIELD_SPI_CS, _data);
-#endif
+  write(_addr, &_data, 1);
   return 1;
 }
 
 uint16_t W5100Class::write(uint16_t _addr, const uint8_t *_buf, uint16_t _len)
 {
-  for (uint16_t i=0; i<_len; i++)
-  {
-#if !defined(SPI_HAS_EXTENDED_CS_PIN_HANDLING)
-    setSS();    
-    SPI.transfer(0xF0);
-    SPI.transfer(_addr >> 8);
-    SPI.transfer(_addr & 0xFF);
-    _addr++;
-    SPI.transfer(_buf[i]);
-    resetSS();
-#else
-    SPI.transfer(ETHERNET_SHIELD_SPI_CS, 0xF0, SPI_CONTINUE);
-    SPI.transfer(ETHERNET_SHIELD_SPI_CS, _addr >> 8, SPI_CONTINUE);
-    SPI.transfer(ETHERNET_SHIELD_SPI_CS, _addr & 0xFF, SPI_CONTINUE);
-    SPI.transfer(ETHERNET_SHIELD_SPI_CS, _buf[i]);
-    _addr++;
-#endif
-  }
-  return _len;
+  // W5500 registers: common block below CH_BASE, one block per socket above
+  if (chip == 55)
+    return spiWrite(_addr & 0xFF, _addr < CH_BASE ? 0 : (((_addr - CH_BASE) >> 3) & 0xE0) | 0x08, _buf, _len);
+  return spiWrite(_addr, 0, _buf, _len);
 }
 
 uint8_t W5100Class::read(uint16_t _addr)
 {
-#if !defined(SPI_HAS_EXTENDED_CS_PIN_HANDLING)
-  setSS();  
-  SPI.transfer(0x0F);
-  SPI.transfer(_addr >> 8);
-  SPI.transfer(_addr & 0xFF);
-  uint8_t _data = SPI.transfer(0);
-  resetSS();
-#else
-  SPI.transfer(ETHERNET_SHIELD_SPI_CS, 0x0F, SPI_CONTINUE);
-  SPI.transfer(ETHERNET_SHIELD_SPI_CS, _addr >> 8, SPI_CONTINUE);
-  SPI.transfer(ETHERNET_SHIELD_SPI_CS, _addr & 0xFF, SPI_CONTINUE);
-  uint8_t _data = SPI.transfer(ETHERNET_SHIELD_SPI_CS, 0);
-#endif
+  uint8_t _data;
+  read(_addr, &_data, 1);
   return _data;
 }
 
 uint16_t W5100Class::read(uint16_t _addr, uint8_t *_buf, uint16_t _len)
 {
+  if (chip == 55)
+    return spiRead(_addr & 0xFF, _addr < CH_BASE ? 0 : (((_addr - CH_BASE) >> 3) & 0xE0) | 0x08, _buf, _len);
+  return spiRead(_addr, 0, _buf, _len);
+}
+
+uint16_t W5100Class::spiWrite(uint16_t _addr, uint8_t _control, const uint8_t *_buf, uint16_t _len)
+{
+  if (chip == 51)
+  {
+    // W5100: opcode, address and data byte in every frame
+    for (uint16_t i=0; i<_len; i++)
+    {
+      setSS();
+      SPI.transfer(0xF0);
+      SPI.transfer(_addr >> 8);
+      SPI.transfer(_addr & 0xFF);
+      _addr++;
+      SPI.transfer(_buf[i]);
+      resetSS();
+    }
+    return _len;
+  }
+
+  setSS();
+  SPI.transfer(_addr >> 8);
+  SPI.transfer(_addr & 0xFF);
+  if (chip == 52)
+  {
+    // W5200: write bit and 15-bit length
+    SPI.transfer(0x80 | (_len >> 8));
+    SPI.transfer(_len & 0xFF);
+  }
+  else
+  {
+    // W5500: block select, write bit, variable length data mode
+    SPI.transfer(_control | 0x04);
+  }
   for (uint16_t i=0; i<_len; i++)
+    SPI.transfer(_buf[i]);
+  resetSS();
+  return _len;
+}
+
+uint16_t W5100Class::spiRead(uint16_t _addr, uint8_t _control, uint8_t *_buf, uint16_t _len)
+{
+  if (chip == 51)
+  {
+    // W5100: opcode, address and dummy byte in every frame
+    for (uint16_t i=0; i<_len; i++)
+    {
+      setSS();
+      SPI.transfer(0x0F);
+      SPI.transfer(_addr >> 8);
+      SPI.transfer(_addr & 0xFF);
+      _addr++;
+      _buf[i] = SPI.transfer(0);
+      resetSS();
+    }
+    return _len;
+  }
+
+  setSS();
+  SPI.transfer(_addr >> 8);
+  SPI.transfer(_addr & 0xFF);
+  if (chip == 52)
   {
-#if !defined(SPI_HAS_EXTENDED_CS_PIN_HANDLING)
-    setSS();
-    SPI.transfer(0x0F);
-    SPI.transfer(_addr >> 8);
-    SPI.transfer(_addr & 0xFF);
-    _addr++;
-    _buf[i] = SPI.transfer(0);
-    resetSS();
-#else
-    SPI.transfer(ETHERNET_SHIELD_SPI_CS, 0x0F, SPI_CONTINUE);
-    SPI.transfer(ETHERNET_SHIELD_SPI_CS, _addr >> 8, SPI_CONTINUE);
-    SPI.transfer(ETHERNET_SHIELD_SPI_CS, _addr & 0xFF, SPI_CONTINUE);
-    _buf[i] = SPI.transfer(ETHERNET_SHIELD_SPI_CS, 0);
-    _addr++;
-#endif
+    // W5200: read bit (clear) and 15-bit length
+    SPI.transfer((_len >> 8) & 0x7F);
+    SPI.transfer(_len & 0xFF);
   }
+  else
+  {
+    // W5500: block select, read bit (clear), variable length data mode
+    SPI.transfer(_control);
+  }
+  // Whatever is in the buffer is clocked out as dummy bytes
+  SPI.transfer(_buf, _len);
+  resetSS();
   return _len;
 }
 
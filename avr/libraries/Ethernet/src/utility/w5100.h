@@ -12,9 +12,22 @@
 
 #include <SPI.h>
 
+// Define ETHERNET_CS_PIN to drive the chip select from any digital pin
+// instead of the board's default
+#ifdef ETHERNET_CS_PIN
+#define ETHERNET_SHIELD_SPI_CS ETHERNET_CS_PIN
+#else
 #define ETHERNET_SHIELD_SPI_CS 10
+#endif
 
+// Sockets in use. Fewer sockets means less RAM for per-socket state and
+// bigger default buffers for each of them
+#ifndef MAX_SOCK_NUM
 #define MAX_SOCK_NUM 4
+#endif
+#if MAX_SOCK_NUM < 1 || MAX_SOCK_NUM > 4
+#error "MAX_SOCK_NUM must be between 1 and 4"
+#endif
 
 typedef uint8_t SOCKET;
 
@@ -130,7 +143,17 @@ public:
 class W5100Class {
 
 public:
-  void init();
+  /**
+   * @brief	Resets the chip and works out whether a W5100, W5200 or W5500 is fitted.
+   * @return 1 if a supported chip answered and the buffer sizes fit it, 0 otherwise
+   */
+  uint8_t init();
+
+  /**
+   * @brief	Chip found by init(): 51 for a W5100, 52 for a W5200, 55 for a W5500
+   *        and 0 if nothing answered.
+   */
+  static inline uint8_t getChip() { return chip; }
 
   /**
    * @brief	This function is being used for copy the data form Receive buffer of the chip to application buffer.
@@ -140,6 +163,14 @@ public:
    * the Rx memory uper-bound of socket.
    */
   void read_data(SOCKET s, volatile uint16_t src, volatile uint8_t * dst, uint16_t len);
+
+  /**
+   * @brief	Counterpart of read_data() for the Transmit buffer.
+   *
+   * ptr is the raw TX write pointer, the wrap-around at the socket buffer
+   * boundary is handled here (or by the chip itself on the W5500).
+   */
+  void write_data(SOCKET s, uint16_t ptr, const uint8_t *src, uint16_t len);
   
   /**
    * @brief	 This function is being called by send() and sendto() function also. 
@@ -189,6 +220,30 @@ public:
   
   uint16_t getTXFreeSize(SOCKET s);
   uint16_t getRXReceivedSize(SOCKET s);
+
+  /**
+   * @brief	Ask for a TX and RX buffer of the given size in KB for a socket; takes
+   *        effect on the next init(). Sizes are 0 or powers of two up to 8 KB on the
+   *        W5100 and 16 KB on the W5200/W5500, and all sockets together can't have
+   *        more than 8 KB (W5100) or 16 KB (W5200/W5500) each way. The sockets not
+   *        asked for share what is left. A W5100 socket can only have 0 KB once the
+   *        sockets before it have all the memory.
+   * @return 0 if the sizes don't fit, and nothing is changed. Before init() they are
+   *        checked against 16 KB, and init() fails if they don't fit the chip found.
+   */
+  static uint8_t setBufferSize(SOCKET s, uint8_t txKB, uint8_t rxKB);
+  static inline uint16_t getTXBufferSize(SOCKET s) { return (uint16_t)txKB[s] << 10; }
+  static inline uint16_t getRXBufferSize(SOCKET s) { return (uint16_t)rxKB[s] << 10; }
+
+  /**
+   * @brief	Let the RECV, DISCON, CON and TIMEOUT events of every socket pull the INT pin low.
+   */
+  void enableSocketInterrupts();
+  /**
+   * @brief	Bit mask of the sockets with an interrupt pending, bit 0 for socket 0.
+   *        Clearing the socket's Sn_IR clears its bit.
+   */
+  uint8_t readSocketInterrupts();
   
 
   // W5100 Registers
@@ -198,6 +253,12 @@ private:
   static uint16_t write(uint16_t addr, const uint8_t *buf, uint16_t len);
   static uint8_t read(uint16_t addr);
   static uint16_t read(uint16_t addr, uint8_t *buf, uint16_t len);
+
+  // One SPI access covering a contiguous span. The W5100 needs a 4-byte
+  // frame per data byte, the W5200 and W5500 send a single header per span.
+  // control is the W5500 block select byte and is ignored by the others.
+  static uint16_t spiWrite(uint16_t addr, uint8_t control, const uint8_t *buf, uint16_t len);
+  static uint16_t spiRead(uint16_t addr, uint8_t control, uint8_t *buf, uint16_t len);
   
 #define __GP_REGISTER8(name, address)             \
   static inline void write##name(uint8_t _data) { \
@@ -208,13 +269,14 @@ private:
   }
 #define __GP_REGISTER16(name, address)            \
   static void write##name(uint16_t _data) {       \
-    write(address,   _data >> 8);                 \
-    write(address+1, _data & 0xFF);               \
+    uint8_t buf[2] = { (uint8_t)(_data >> 8),     \
+                       (uint8_t)(_data & 0xFF) }; \
+    write(address, buf, 2);                       \
   }                                               \
   static uint16_t read##name() {                  \
-    uint16_t res = read(address);                 \
-    res = (res << 8) + read(address + 1);         \
-    return res;                                   \
+    uint8_t buf[2];                               \
+    read(address, buf, 2);                        \
+    return (buf[0] << 8) | buf[1];                \
   }
 #define __GP_REGISTER_N(name, address, size)      \
   static uint16_t write##name(uint8_t *_buff) {   \
@@ -241,6 +303,14 @@ public:
   __GP_REGISTER8 (PMAGIC, 0x0029);    // PPP LCP Magic Number
   __GP_REGISTER_N(UIPR,   0x002A, 4); // Unreachable IP address in UDP mode
   __GP_REGISTER16(UPORT,  0x002E);    // Unreachable Port address in UDP mode
+  __GP_REGISTER8 (VERSIONR_W5200, 0x001F);  // Chip version (W5200 only)
+  __GP_REGISTER16(RTR_W5500,      0x0019);  // Timeout address (W5500 only)
+  __GP_REGISTER8 (RCR_W5500,      0x001B);  // Retry count (W5500 only)
+  __GP_REGISTER8 (VERSIONR_W5500, 0x0039);  // Chip version (W5500 only)
+  __GP_REGISTER8 (IR2_W5200,      0x0034);  // Socket interrupt (W5200 only)
+  __GP_REGISTER8 (IMR_W5200,      0x0036);  // Socket interrupt mask (W5200 only)
+  __GP_REGISTER8 (SIR_W5500,      0x0017);  // Socket interrupt (W5500 only)
+  __GP_REGISTER8 (SIMR_W5500,     0x0018);  // Socket interrupt mask (W5500 only)
   
 #undef __GP_REGISTER8
 #undef __GP_REGISTER16
@@ -254,7 +324,8 @@ private:
   static inline uint16_t readSn(SOCKET _s, uint16_t _addr, uint8_t *_buf, uint16_t len);
   static inline uint16_t writeSn(SOCKET _s, uint16_t _addr, uint8_t *_buf, uint16_t len);
 
-  static const uint16_t CH_BASE = 0x0400;
+  // Socket register base, set by init() for the chip that was found
+  static uint16_t CH_BASE;
   static const uint16_t CH_SIZE = 0x0100;
 
 #define __SOCKET_REGISTER8(name, address)                    \
@@ -266,16 +337,14 @@ private:
   }
 #define __SOCKET_REGISTER16(name, address)                   \
   static void write##name(SOCKET _s, uint16_t _data) {       \
-    writeSn(_s, address,   _data >> 8);                      \
-    writeSn(_s, address+1, _data & 0xFF);                    \
+    uint8_t buf[2] = { (uint8_t)(_data >> 8),                \
+                       (uint8_t)(_data & 0xFF) };            \
+    writeSn(_s, address, buf, 2);                            \
   }                                                          \
   static uint16_t read##name(SOCKET _s) {                    \
-    uint16_t res = readSn(_s, address);                      \
-    uint16_t res2 = readSn(_s,address + 1);                  \
-    res = res << 8;                                          \
-    res2 = res2 & 0xFF;                                      \
-    res = res | res2;                                        \
-    return res;                                              \
+    uint8_t buf[2];                                          \
+    readSn(_s, address, buf, 2);                             \
+    return (buf[0] << 8) | buf[1];                           \
   }
 #define __SOCKET_REGISTER_N(name, address, size)             \
   static uint16_t write##name(SOCKET _s, uint8_t *_buff) {   \
@@ -304,6 +373,9 @@ public:
   __SOCKET_REGISTER16(SnRX_RSR,   0x0026)        // RX Free Size
   __SOCKET_REGISTER16(SnRX_RD,    0x0028)        // RX Read Pointer
   __SOCKET_REGISTER16(SnRX_WR,    0x002A)        // RX Write Pointer (supported?)
+  __SOCKET_REGISTER8(SnIMR,       0x002C)        // Interrupt Mask (W5200/W5500 only)
+  __SOCKET_REGISTER8(SnRXBUF_SIZE, 0x001E)       // RX Buffer Size in KB (W5200/W5500 only)
+  __SOCKET_REGISTER8(SnTXBUF_SIZE, 0x001F)       // TX Buffer Size in KB (W5200/W5500 only)
   
 #undef __SOCKET_REGISTER8
 #undef __SOCKET_REGISTER16
@@ -313,20 +385,25 @@ public:
 private:
   static const uint8_t  RST = 7; // Reset BIT
 
-  static const int SOCKETS = 4;
-  static const uint16_t SMASK = 0x07FF; // Tx buffer MASK
-  static const uint16_t RMASK = 0x07FF; // Rx buffer MASK
-public:
-  static const uint16_t SSIZE = 2048; // Max Tx buffer size
-private:
-  static const uint16_t RSIZE = 2048; // Max Rx buffer size
-  uint16_t SBASE[SOCKETS]; // Tx buffer base address
-  uint16_t RBASE[SOCKETS]; // Rx buffer base address
+  static uint8_t chip;
+  static uint8_t softReset();
+  static uint8_t isW5100();
+  static uint8_t isW5200();
+  static uint8_t isW5500();
+
+  static uint8_t setBufferSizes();
+
+  static uint8_t txKB[MAX_SOCK_NUM]; // Tx buffer size in KB
+  static uint8_t rxKB[MAX_SOCK_NUM]; // Rx buffer size in KB
+  static uint8_t txAsked[MAX_SOCK_NUM]; // sizes given to setBufferSize()
+  static uint8_t rxAsked[MAX_SOCK_NUM];
+  static uint8_t asked;                 // bit mask of the sockets given one
+  uint16_t SBASE[MAX_SOCK_NUM]; // Tx buffer base address
+  uint16_t RBASE[MAX_SOCK_NUM]; // Rx buffer base address
 
 private:
-#if !defined(SPI_HAS_EXTENDED_CS_PIN_HANDLING)
   #define SPI_ETHERNET_SETTINGS SPISettings(4000000, MSBFIRST, SPI_MODE0)
-  #if defined(ARDUINO_ARCH_AVR)
+  #if defined(ARDUINO_ARCH_AVR) && !defined(ETHERNET_CS_PIN)
     #if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
       inline static void initSS()    { DDRB  |=  _BV(4); };
       inline static void setSS()     { PORTB &= ~_BV(4); };
@@ -338,6 +415,15 @@ private:
       inline static void initSS()    { DDRB  |=  _BV(0); };
       inline static void setSS()     { PORTB &= ~_BV(0); };
       inline static void resetSS()   { PORTB |=  _BV(0); };  
+
+    // ButterflyCore. PB0 is also the CS of the Butterfly's onboard dataflash;
+    // define ETHERNET_CS_PIN to use both on the same bus
+    #elif defined(__AVR_ATmega169__) || defined(__AVR_ATmega169P__) \
+    || defined(__AVR_ATmega329__) || defined(__AVR_ATmega329P__) \
+    || defined(__AVR_ATmega649__) || defined(__AVR_ATmega649P__)
+      inline static void initSS()    { DDRB  |=  _BV(0); };
+      inline static void setSS()     { PORTB &= ~_BV(0); };
+      inline static void resetSS()   { PORTB |=  _BV(0); };
   	
   	//MightyCore
 	#elif defined(__AVR_ATmega1284__) || defined(__AVR_ATmega1284P__) \
@@ -379,10 +465,6 @@ private:
       *portOutputRegister(digitalPinToPort(ETHERNET_SHIELD_SPI_CS)) |= digitalPinToBitMask(ETHERNET_SHIELD_SPI_CS);
     }
   #endif
-#else
-  #define SPI_ETHERNET_SETTINGS ETHERNET_SHIELD_SPI_CS,SPISettings(4000000, MSBFIRST, SPI_MODE0)
-  // initSS(), setSS(), resetSS() not needed with EXTENDED_CS_PIN_HANDLING
-#endif
 };
 
 extern W5100Class W5100;
@@ -436,11 +518,17 @@ void W5100Class::setIPAddress(uint8_t *_addr) {
 }
 
 void W5100Class::setRetransmissionTime(uint16_t _timeout) {
-  writeRTR(_timeout);
+  if (chip == 55)
+    writeRTR_W5500(_timeout);
+  else
+    writeRTR(_timeout);
 }
 
 void W5100Class::setRetransmissionCount(uint8_t _retry) {
-  writeRCR(_retry);
+  if (chip == 55)
+    writeRCR_W5500(_retry);
+  else
+    writeRCR(_retry);
 }
 
 #endif
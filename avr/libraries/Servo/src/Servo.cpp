@@ -37,6 +37,14 @@ static volatile int8_t Channel[_Nbr_16timers ];             // counter for the s
 
 uint8_t ServoCount = 0;                                     // the total number of attached servos
 
+// Weakly referenced, so attach() doesn't pull in the clock scaling code
+extern "C" uint8_t attachClockChange(void (*callback)(void)) __attribute__((weak));
+
+// usToTicks() assumes timer 1 ticks at F_CPU / 8. With the CPU clock
+// divided by setClockDivider() it ticks 2^tickShift times slower, even with
+// the prescaler down to 1 from a divider of 8 up
+static uint8_t tickShift = 0;
+
 
 // convenience macros
 #define SERVO_INDEX_TO_TIMER(_servo_nbr) ((timer16_Sequence_t)(_servo_nbr / SERVOS_PER_TIMER)) // returns the timer controlling this servo
@@ -60,14 +68,14 @@ static inline void handle_interrupts(timer16_Sequence_t timer, volatile uint16_t
 
   Channel[timer]++;    // increment to the next channel
   if( SERVO_INDEX(timer,Channel[timer]) < ServoCount && Channel[timer] < SERVOS_PER_TIMER) {
-    *OCRnA = *TCNTn + SERVO(timer,Channel[timer]).ticks;
+    *OCRnA = *TCNTn + (SERVO(timer,Channel[timer]).ticks >> tickShift);
     if(SERVO(timer,Channel[timer]).Pin.isActive == true)     // check if activated
       digitalWrite( SERVO(timer,Channel[timer]).Pin.nbr,HIGH); // its an active channel so pulse it high
   }
   else {
     // finished all channels so wait for the refresh period to expire before starting over
-    if( ((unsigned)*TCNTn) + 4 < usToTicks(REFRESH_INTERVAL) )  // allow a few ticks to ensure the next OCR1A not missed
-      *OCRnA = (unsigned int)usToTicks(REFRESH_INTERVAL);
+    if( ((unsigned)*TCNTn) + 4 < (usToTicks(REFRESH_INTERVAL) >> tickShift) )  // allow a few ticks to ensure the next OCR1A not missed
+      *OCRnA = (unsigned int)usToTicks(REFRESH_INTERVAL) >> tickShift;
     else
       *OCRnA = *TCNTn + 4;  // at least REFRESH_INTERVAL has elapsed
     Channel[timer] = -1; // this will get incremented at the end of the refresh period to start again at the first channel
@@ -121,12 +129,31 @@ void Timer3Service()
 #endif
 
 
+#if defined (_useTimer1)
+// Prescaler bits for timer 1 at the current clock divider
+static uint8_t timer1Prescaler()
+{
+  uint8_t divider = getClockDivider();
+
+  if(divider >= CLOCK_DIV8) {
+    tickShift = divider - CLOCK_DIV8;
+    return _BV(CS10);
+  }
+  tickShift = divider;
+  return _BV(CS11);
+}
+
+static void servoClockChanged();
+#endif
+
 static void initISR(timer16_Sequence_t timer)
 {
 #if defined (_useTimer1)
   if(timer == _timer1) {
     TCCR1A = 0;             // normal counting mode
-    TCCR1B = _BV(CS11);     // set prescaler of 8
+    TCCR1B = timer1Prescaler(); // set prescaler of 8, or less for a divided clock
+    if(attachClockChange)
+      attachClockChange(servoClockChanged);
     TCNT1 = 0;              // clear the timer count
 #if defined(__AVR_ATmega8__) || defined(__AVR_ATmega8535__) || defined(__AVR_ATmega16__) \
 || defined(__AVR_ATmega32__) || defined(__AVR_ATmega64__) || defined(__AVR_ATmega128__)
@@ -217,6 +244,15 @@ static boolean isTimerActive(timer16_Sequence_t timer)
   return false;
 }
 
+#if defined (_useTimer1)
+// Called after setClockDivider()
+static void servoClockChanged()
+{
+  if(isTimerActive(_timer1))
+    TCCR1B = timer1Prescaler();
+}
+#endif
+
 
 /****************** end of static functions ******************************/
 
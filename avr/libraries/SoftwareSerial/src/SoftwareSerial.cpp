@@ -48,9 +48,7 @@ http://arduiniana.org.
 // Statics
 //
 SoftwareSerial *SoftwareSerial::active_object = 0;
-char SoftwareSerial::_receive_buffer[_SS_MAX_RX_BUFF]; 
-volatile uint8_t SoftwareSerial::_receive_buffer_tail = 0;
-volatile uint8_t SoftwareSerial::_receive_buffer_head = 0;
+RingBuffer<_SS_MAX_RX_BUFF> SoftwareSerial::_receive_buffer;
 
 //
 // Debugging
@@ -93,7 +91,7 @@ bool SoftwareSerial::listen()
       active_object->stopListening();
 
     _buffer_overflow = false;
-    _receive_buffer_head = _receive_buffer_tail = 0;
+    _receive_buffer.clear();
     active_object = this;
 
     setRxIntMsk(true);
@@ -166,14 +164,7 @@ void SoftwareSerial::recv()
       d = ~d;
 
     // if buffer full, set the overflow flag and return
-    uint8_t next = (_receive_buffer_tail + 1) % _SS_MAX_RX_BUFF;
-    if (next != _receive_buffer_head)
-    {
-      // save new data in buffer: tail points to where byte goes
-      _receive_buffer[_receive_buffer_tail] = d; // save new byte
-      _receive_buffer_tail = next;
-    } 
-    else 
+    if (!_receive_buffer.push(d))
     {
       DebugPulse(_DEBUG_PIN1, 1);
       _buffer_overflow = true;
@@ -393,12 +384,10 @@ int SoftwareSerial::read()
     return -1;
 
   // Empty buffer?
-  if (_receive_buffer_head == _receive_buffer_tail)
+  uint8_t d;
+  if (!_receive_buffer.pop(d))
     return -1;
 
-  // Read from "head"
-  uint8_t d = _receive_buffer[_receive_buffer_head]; // grab next byte
-  _receive_buffer_head = (_receive_buffer_head + 1) % _SS_MAX_RX_BUFF;
   return d;
 }
 
@@ -407,7 +396,7 @@ int SoftwareSerial::available()
   if (!isListening())
     return 0;
 
-  return (_receive_buffer_tail + _SS_MAX_RX_BUFF - _receive_buffer_head) % _SS_MAX_RX_BUFF;
+  return _receive_buffer.available();
 }
 
 size_t SoftwareSerial::write(uint8_t b)
@@ -470,10 +459,7 @@ void SoftwareSerial::flush()
   if (!isListening())
     return;
 
-  uint8_t oldSREG = SREG;
-  cli();
-  _receive_buffer_head = _receive_buffer_tail = 0;
-  SREG = oldSREG;
+  _receive_buffer.clear();
 }
 
 int SoftwareSerial::peek()
@@ -482,9 +468,8 @@ int SoftwareSerial::peek()
     return -1;
 
   // Empty buffer?
-  if (_receive_buffer_head == _receive_buffer_tail)
+  if (_receive_buffer.empty())
     return -1;
 
-  // Read from "head"
-  return _receive_buffer[_receive_buffer_head];
+  return _receive_buffer.peek();
 }
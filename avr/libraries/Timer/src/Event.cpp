@@ -36,7 +36,11 @@ Event::Event(void)
 
 void Event::update(void)
 {
-    unsigned long now = millis();
+    update(millis());
+}
+
+void Event::update(unsigned long now)
+{
     if (now - lastEventTime >= period)
     {
         switch (eventType)
@@ -50,9 +54,18 @@ void Event::update(void)
                 digitalWrite(pin, pinState);
                 break;
         }
-        lastEventTime = now;
-        count++;
+        advance(now);
     }
+    else if (repeatCount > -1 && count >= repeatCount)
+    {
+        eventType = EVENT_NONE;
+    }
+}
+
+void Event::advance(unsigned long now)
+{
+    lastEventTime = now;
+    count++;
     if (repeatCount > -1 && count >= repeatCount)
     {
         eventType = EVENT_NONE;
@@ -35,6 +35,11 @@ class Event
 public:
   Event(void);
   void update(void);
+  void update(unsigned long now);
+  // Count the event as fired at now, without running it
+  void advance(unsigned long now);
+  // When the event is next due, in millis() time
+  unsigned long deadline(void) { return lastEventTime + period; }
   int8_t eventType;
   unsigned long period;
   int repeatCount;
@@ -29,8 +29,46 @@
 
 #include "Timer.h"
 
+Timer* Timer::_isrTimer;
+void (* volatile Timer::_queueCallback[TIMER_QUEUE_SIZE])(void*);
+void* volatile Timer::_queueContext[TIMER_QUEUE_SIZE];
+volatile uint8_t Timer::_queueHead;
+volatile uint8_t Timer::_queueTail;
+
+// Weakly referenced, so useInterrupt() doesn't pull in the clock scaling code
+extern "C" uint8_t attachClockChange(void (*callback)(void)) __attribute__((weak));
+
+// In interrupt mode Timer1 ticks at F_CPU / 2^tickShift: clk/64, or less
+// for a clock divided by setClockDivider()
+static uint8_t tickShift;
+
+// Prescaler bits for Timer1 at the current clock divider
+static uint8_t timer1Prescaler()
+{
+    uint8_t divider = getClockDivider();
+
+    if (divider == CLOCK_DIV1)
+    {
+        tickShift = 6;
+        return _BV(CS11) | _BV(CS10);
+    }
+    if (divider <= CLOCK_DIV8)
+    {
+        tickShift = divider + 3;
+        return _BV(CS11);
+    }
+    tickShift = divider;
+    return _BV(CS10);
+}
+
+static void timerClockChanged()
+{
+    Timer::handleClockChange();
+}
+
 Timer::Timer(void)
 {
+    _heapSize = 0;
 }
 
 int8_t Timer::every(unsigned long period, void (*callback)(void*), int repeatCount, void* context)
@@ -45,6 +83,12 @@ int8_t Timer::every(unsigned long period, void (*callback)(void*), int repeatCou
     _events[i].lastEventTime = millis();
     _events[i].count = 0;
     _events[i].context = context;
+
+    uint8_t oldSREG = SREG;
+    cli();
+    heapInsert(i);
+    if (_isrTimer == this) armInterrupt();
+    SREG = oldSREG;
     return i;
 }
 
@@ -73,6 +117,12 @@ int8_t Timer::oscillate(uint8_t pin, unsigned long period, uint8_t startingValue
     _events[i].count = 0;
     _events[i].context = (void*)0;
     _events[i].callback = (void (*)(void*))0;
+
+    uint8_t oldSREG = SREG;
+    cli();
+    heapInsert(i);
+    if (_isrTimer == this) armInterrupt();
+    SREG = oldSREG;
     return i;
 }
 
@@ -107,7 +157,14 @@ int8_t Timer::pulseImmediate(uint8_t pin, unsigned long period, uint8_t pulseVal
 int8_t Timer::stop(int8_t id)
 {
     if (id >= 0 && id < MAX_NUMBER_OF_EVENTS) {
-        _events[id].eventType = EVENT_NONE;
+        uint8_t oldSREG = SREG;
+        cli();
+        if (_events[id].eventType != EVENT_NONE)
+        {
+            heapRemove(id);
+            _events[id].eventType = EVENT_NONE;
+        }
+        SREG = oldSREG;
         return TIMER_NOT_AN_EVENT;
     }
     return id;
@@ -115,13 +172,179 @@ int8_t Timer::stop(int8_t id)
 
 void Timer::update(void)
 {
-    for (int8_t i = 0; i < MAX_NUMBER_OF_EVENTS; i++)
+    // Callbacks queued by the interrupt
+    while (_queueTail != _queueHead)
+    {
+        uint8_t i = _queueTail;
+        void (*callback)(void*) = _queueCallback[i];
+        void* context = _queueContext[i];
+        _queueTail = (i + 1) & (TIMER_QUEUE_SIZE - 1);
+        (*callback)(context);
+    }
+
+    if (_isrTimer == this || _heapSize == 0) return;
+    run(millis(), false);
+}
+
+// Run the events that are due at now. With deferred set (in the interrupt)
+// callbacks are queued for update() rather than called
+void Timer::run(unsigned long now, bool deferred)
+{
+    // Only the first event in the heap can be due before the others. No
+    // more events are run than there were, so an event with a period of 0
+    // can't keep update() busy
+    for (uint8_t n = _heapSize; n > 0 && _heapSize > 0 &&
+         (long)(now - _events[_heap[0]].deadline()) >= 0; n--)
+    {
+        int8_t i = _heap[0];
+        if (deferred && _events[i].eventType == EVENT_EVERY)
+        {
+            uint8_t next = (_queueHead + 1) & (TIMER_QUEUE_SIZE - 1);
+            // With the queue full the event stays due until the next tick
+            if (next == _queueTail) break;
+            _queueCallback[_queueHead] = _events[i].callback;
+            _queueContext[_queueHead] = _events[i].context;
+            _queueHead = next;
+            _events[i].advance(now);
+        }
+        else
+        {
+            _events[i].update(now);
+        }
+
+        // The callback may have stopped or started events, this one included
+        if (_events[i].eventType == EVENT_NONE)
+        {
+            if (_heapPos[i] < _heapSize && _heap[_heapPos[i]] == i)
+            {
+                heapRemove(i);
+            }
+        }
+        else
+        {
+            heapFix(_heapPos[i]);
+        }
+    }
+}
+
+unsigned long Timer::nextDeadline(void)
+{
+    uint8_t oldSREG = SREG;
+    cli();
+    if (_heapSize == 0)
+    {
+        SREG = oldSREG;
+        return TIMER_NO_DEADLINE;
+    }
+    unsigned long deadline = _events[_heap[0]].deadline();
+    SREG = oldSREG;
+
+    long left = (long)(deadline - millis());
+    return left > 0 ? left : 0;
+}
+
+void Timer::idle(void)
+{
+    update();
+    // Callbacks run by update() may have been queued by the interrupt in
+    // the meantime; don't sleep on them
+    if (_queueTail != _queueHead) return;
+    ::idle(nextDeadline());
+
+    // Timer1 stands still in power-save sleep, so its compare match is
+    // late by however long that was; catch up with millis()
+    if (_isrTimer == this)
+    {
+        uint8_t oldSREG = SREG;
+        cli();
+        run(millis(), true);
+        armInterrupt();
+        SREG = oldSREG;
+    }
+}
+
+void Timer::useInterrupt(bool enable)
+{
+    uint8_t oldSREG = SREG;
+    cli();
+    if (enable)
+    {
+        _isrTimer = this;
+        // Normal mode, with compare B set for the next deadline. This
+        // disconnects OC1A and OC1B from their pins
+        TCCR1A = 0;
+        TCCR1B = timer1Prescaler();
+        if (attachClockChange)
+            attachClockChange(timerClockChanged);
+        TCNT1 = 0;
+        armInterrupt();
+        TIFR1 = _BV(OCF1B);
+        TIMSK1 |= _BV(OCIE1B);
+    }
+    else if (_isrTimer == this)
+    {
+        TIMSK1 &= ~_BV(OCIE1B);
+        // Back to the 8-bit phase correct PWM set up by init()
+#if F_CPU >= 8000000L
+        TCCR1B = _BV(CS11) | _BV(CS10);
+#else
+        TCCR1B = _BV(CS11);
+#endif
+        TCCR1A = _BV(WGM10);
+        _isrTimer = 0;
+    }
+    SREG = oldSREG;
+}
+
+void Timer::handleInterrupt(void)
+{
+    if (_isrTimer)
+    {
+        _isrTimer->run(millis(), true);
+        _isrTimer->armInterrupt();
+    }
+}
+
+// Called after setClockDivider()
+void Timer::handleClockChange(void)
+{
+    uint8_t oldSREG = SREG;
+    cli();
+    if (_isrTimer)
+    {
+        TCCR1B = timer1Prescaler();
+        _isrTimer->armInterrupt();
+    }
+    SREG = oldSREG;
+}
+
+// Set compare B for the first deadline in the heap, so the interrupt
+// doesn't wake the CPU until there is something to do. A deadline more
+// than half a Timer1 cycle away is reached in steps. Called with
+// interrupts off
+void Timer::armInterrupt(void)
+{
+    unsigned long ticks = 0x8000;
+
+    if (_heapSize > 0)
     {
-        if (_events[i].eventType != EVENT_NONE)
+        long left = (long)(_events[_heap[0]].deadline() - millis());
+        // Still due if the queue was full; try again in a millisecond
+        if (left < 1) left = 1;
+        if (left < 0x8000)
         {
-            _events[i].update();
+            ticks = ((F_CPU / 1000) * (unsigned long)left) >> tickShift;
         }
     }
+    if (ticks > 0x8000) ticks = 0x8000;
+    // Far enough ahead that TCNT1 can't pass it before it is set
+    if (ticks < 16) ticks = 16;
+    OCR1B = TCNT1 + (uint16_t)ticks;
+}
+
+ISR(TIMER1_COMPB_vect)
+{
+    Timer::handleInterrupt();
 }
 
 int8_t Timer::findFreeEventIndex(void)
@@ -135,3 +358,59 @@ int8_t Timer::findFreeEventIndex(void)
     }
     return NO_TIMER_AVAILABLE;
 }
+
+// Deadlines are compared as a signed difference, like millis() intervals,
+// so the order holds across the millis() rollover
+bool Timer::heapBefore(uint8_t a, uint8_t b)
+{
+    return (long)(_events[_heap[a]].deadline() - _events[_heap[b]].deadline()) < 0;
+}
+
+void Timer::heapSwap(uint8_t a, uint8_t b)
+{
+    int8_t id = _heap[a];
+    _heap[a] = _heap[b];
+    _heap[b] = id;
+    _heapPos[_heap[a]] = a;
+    _heapPos[_heap[b]] = b;
+}
+
+// Move the event at pos up or down until the heap is in order again
+void Timer::heapFix(uint8_t pos)
+{
+    while (pos > 0 && heapBefore(pos, (pos - 1) / 2))
+    {
+        heapSwap(pos, (pos - 1) / 2);
+        pos = (pos - 1) / 2;
+    }
+    for (;;)
+    {
+        uint8_t first = pos;
+        uint8_t child = 2 * pos + 1;
+        if (child < _heapSize && heapBefore(child, first)) first = child;
+        child++;
+        if (child < _heapSize && heapBefore(child, first)) first = child;
+        if (first == pos) break;
+        heapSwap(pos, first);
+        pos = first;
+    }
+}
+
+void Timer::heapInsert(int8_t id)
+{
+    _heap[_heapSize] = id;
+    _heapPos[id] = _heapSize;
+    _heapSize++;
+    heapFix(_heapSize - 1);
+}
+
+void Timer::heapRemove(int8_t id)
+{
+    uint8_t pos = _heapPos[id];
+    _heapSize--;
+    if (pos != _heapSize)
+    {
+        heapSwap(pos, _heapSize);
+        heapFix(pos);
+    }
+}
@@ -26,11 +26,24 @@
 #include <inttypes.h>
 #include "Event.h"
 
+// Events are kept in a heap ordered by when they are next due, so update()
+// only looks at the first one and a timer can hold dozens of them. Each
+// event costs about 24 bytes of RAM. Ids are int8_t, so 127 at most.
+#ifndef MAX_NUMBER_OF_EVENTS
 #define MAX_NUMBER_OF_EVENTS (10)
+#endif
 
 #define TIMER_NOT_AN_EVENT (-2)
 #define NO_TIMER_AVAILABLE (-1)
 
+// nextDeadline() when there is nothing to wait for
+#define TIMER_NO_DEADLINE (0xFFFFFFFFUL)
+
+// Callbacks that can wait for update() in interrupt mode; a power of two
+#ifndef TIMER_QUEUE_SIZE
+#define TIMER_QUEUE_SIZE (8)
+#endif
+
 class Timer
 {
 
@@ -57,10 +70,59 @@ public:
   int8_t stop(int8_t id);
   void update(void);
 
+  /**
+   * Milliseconds until the next event is due, 0 if one is due already, or
+   * TIMER_NO_DEADLINE if there are no events. Lets the caller sleep until
+   * update() has something to do.
+   */
+  unsigned long nextDeadline(void);
+
+  /**
+   * Run what is due, then sleep with idle() until the next event or until
+   * an interrupt wakes the CPU. Call from loop() instead of update().
+   */
+  void idle(void);
+
+  /**
+   * Run this timer's events from a Timer1 interrupt instead of from
+   * update(). The interrupt is set for the next deadline rather than
+   * every millisecond, so idle() sleeps until then, and it follows
+   * setClockDivider(). Pins are switched in the interrupt, on time whatever loop()
+   * is doing; callbacks are queued and run by the next update(), which
+   * must still be called from loop() or yield(). Only one Timer can use
+   * the interrupt. Timer1 is taken over, so analogWrite() on pins 13 and 14,
+   * Servo and tone() on Timer1 can't be used at the same time.
+   */
+  void useInterrupt(bool enable = true);
+  // Called from the Timer1 compare B interrupt
+  static void handleInterrupt(void);
+  // Called after setClockDivider()
+  static void handleClockChange(void);
+
 protected:
   Event _events[MAX_NUMBER_OF_EVENTS];
   int8_t findFreeEventIndex(void);
 
+  // Ids of the running events, earliest deadline first, and each event's
+  // position in it
+  int8_t _heap[MAX_NUMBER_OF_EVENTS];
+  uint8_t _heapPos[MAX_NUMBER_OF_EVENTS];
+  uint8_t _heapSize;
+  bool heapBefore(uint8_t a, uint8_t b);
+  void heapSwap(uint8_t a, uint8_t b);
+  void heapFix(uint8_t pos);
+  void heapInsert(int8_t id);
+  void heapRemove(int8_t id);
+  void run(unsigned long now, bool deferred);
+  void armInterrupt(void);
+
+  // Callbacks waiting to be run; written by the interrupt, read by update()
+  static Timer* _isrTimer;
+  static void (* volatile _queueCallback[TIMER_QUEUE_SIZE])(void*);
+  static void* volatile _queueContext[TIMER_QUEUE_SIZE];
+  static volatile uint8_t _queueHead;
+  static volatile uint8_t _queueTail;
+
 };
 
 #endif
@@ -82,7 +82,7 @@ void TwoWire::end(void)
 
 void TwoWire::setClock(uint32_t frequency)
 {
-  TWBR = ((F_CPU / frequency) - 16) / 2;
+  twi_setFrequency(frequency);
 }
 
 uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, uint32_t iaddress, uint8_t isize, uint8_t sendStop)
@@ -186,6 +186,18 @@ uint8_t TwoWire::endTransmission(void)
   return endTransmission(true);
 }
 
+//	Queues a write-then-read transaction and returns immediately. The
+//	transaction runs in the background, reading and writing the caller's
+//	buffers directly, and the callback (if any) is invoked from interrupt
+//	context once transaction->status is no longer TWI_PENDING.
+//	The bus is clocked from a Timer1 interrupt, at up to 40 kHz with a
+//	16 MHz clock, and Timer1 can't be used for anything else meanwhile.
+//
+void TwoWire::submit(WireTransaction *transaction)
+{
+  twi_submit(transaction);
+}
+
 // must be called in:
 // slave tx event callback
 // or after beginTransmission(address)
@@ -24,12 +24,18 @@
 
 #include <inttypes.h>
 #include "Stream.h"
+extern "C" {
+  #include "utility/twi.h"
+}
 
 #define BUFFER_LENGTH 32
 
 // WIRE_HAS_END means Wire has end()
 #define WIRE_HAS_END 1
 
+// Descriptor for Wire.submit(), see utility/twi.h
+typedef twi_transaction WireTransaction;
+
 class TwoWire : public Stream
 {
   private:
@@ -63,6 +69,7 @@ class TwoWire : public Stream
 	uint8_t requestFrom(uint8_t, uint8_t, uint32_t, uint8_t, uint8_t);
     uint8_t requestFrom(int, int);
     uint8_t requestFrom(int, int, int);
+    void submit(WireTransaction *);
     virtual size_t write(uint8_t);
     virtual size_t write(const uint8_t *, size_t);
     virtual int available(void);
@@ -0,0 +1,52 @@
+// Wire Master Queue
+
+// Demonstrates use of the Wire transaction queue
+// Reads a register from two I2C devices in the background
+// while the main loop keeps running
+
+// This example code is in the public domain.
+
+
+#include <Wire.h>
+
+const uint8_t reg = 0x00;   // register to read from both devices
+uint8_t data[2][2];         // two bytes from each device
+WireTransaction request[2];
+
+void done(WireTransaction *t) {
+  // runs from interrupt context, keep it short
+}
+
+void setup() {
+  Wire.begin();        // join i2c bus (address optional for master)
+  Serial.begin(9600);  // start serial for output
+
+  for (uint8_t i = 0; i < 2; i++) {
+    request[i].address = 0x48 + i;  // devices #72 and #73
+    request[i].txData = &reg;       // write the register address,
+    request[i].txLength = 1;
+    request[i].rxData = data[i];    // then read two bytes after a repeated start
+    request[i].rxLength = 2;
+    request[i].callback = done;
+    request[i].status = 0;
+  }
+}
+
+void loop() {
+  for (uint8_t i = 0; i < 2; i++) {
+    if (request[i].status == TWI_PENDING) {
+      continue;                     // still queued or on the bus
+    }
+    Serial.print(request[i].address);
+    Serial.print(": ");
+    if (request[i].status == 0) {
+      Serial.println((data[i][0] << 8) | data[i][1]);
+    } else {
+      Serial.println("no reply");
+    }
+    Wire.submit(&request[i]);       // queue the next read
+  }
+
+  // other work goes here, the bus is serviced in the background
+  delay(100);
+}
@@ -17,39 +17,92 @@
   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
   Modified 2012 by Todd Krein (todd@krein.org) to implement repeated starts
+  Rewritten for the USI (Universal Serial Interface) of the ATmega169/329/649
+  family, which has no TWI module. SDA is PE5 (DI) and SCL is PE4 (USCK)
 */
 
-#include <math.h>
 #include <stdlib.h>
 #include <inttypes.h>
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <util/delay_basic.h>
 #include <compat/twi.h>
-#include "Arduino.h" // for digitalWrite
-
-#ifndef cbi
-#define cbi(sfr, bit) (_SFR_BYTE(sfr) &= ~_BV(bit))
-#endif
-
-#ifndef sbi
-#define sbi(sfr, bit) (_SFR_BYTE(sfr) |= _BV(bit))
-#endif
+#include "Arduino.h"
 
 #include "pins_arduino.h"
 #include "twi.h"
 
+// USI two-wire pins
+#define TWI_DDR   DDRE
+#define TWI_PORT  PORTE
+#define TWI_PIN   PINE
+#define TWI_SDA   PE5
+#define TWI_SCL   PE4
+
+// Master: software clock strobe, shift register clocked on the SCL edges
+#define TWI_USICR_MASTER       (_BV(USIWM1) | _BV(USICS1) | _BV(USICLK))
+// Slave: external clock, start condition interrupt only
+#define TWI_USICR_SLAVE_IDLE   (_BV(USISIE) | _BV(USIWM1) | _BV(USICS1))
+// Slave: external clock, hold SCL low on counter overflow
+#define TWI_USICR_SLAVE_ACTIVE (_BV(USISIE) | _BV(USIOIE) | _BV(USIWM1) | _BV(USIWM0) | _BV(USICS1))
+
+// USISR values: clear the flags and preload the 4-bit edge counter so it
+// overflows after a byte (16 edges), a single bit (2 edges) or one edge.
+// The slave variants leave USISIF alone so a pending start is never lost
+#define TWI_USISR_8BIT         (_BV(USISIF) | _BV(USIOIF) | _BV(USIPF) | _BV(USIDC) | (0x0 << USICNT0))
+#define TWI_USISR_1BIT         (_BV(USISIF) | _BV(USIOIF) | _BV(USIPF) | _BV(USIDC) | (0xE << USICNT0))
+#define TWI_USISR_SLAVE_8BIT   (_BV(USIOIF) | _BV(USIPF) | _BV(USIDC) | (0x0 << USICNT0))
+#define TWI_USISR_SLAVE_1BIT   (_BV(USIOIF) | _BV(USIPF) | _BV(USIDC) | (0xE << USICNT0))
+#define TWI_USISR_SLAVE_1EDGE  (_BV(USIOIF) | _BV(USIPF) | _BV(USIDC) | (0xF << USICNT0))
+
+// Passes of an SCL or SDA wait loop in TWI_TIMEOUT, at about 8 cycles a pass
+#define TWI_TIMEOUT_LOOPS ((uint16_t)((F_CPU / 1000000L) * TWI_TIMEOUT / 8))
+
+// Slave state machine, advanced by the USI counter overflow interrupt
+#define TWI_SLAVE_CHECK_ADDRESS 0
+#define TWI_SLAVE_SEND_DATA     1
+#define TWI_SLAVE_REQUEST_REPLY 2
+#define TWI_SLAVE_CHECK_REPLY   3
+#define TWI_SLAVE_REQUEST_DATA  4
+#define TWI_SLAVE_DATA_EDGE     5
+#define TWI_SLAVE_GET_DATA      6
+
+// Queued transaction steps, each taken when the USI counter overflows at
+// the end of the byte or bit the step before clocked
+#define TWI_QUEUE_ADDRESS       0
+#define TWI_QUEUE_ADDRESS_ACK   1
+#define TWI_QUEUE_DATA          2
+#define TWI_QUEUE_DATA_ACK      3
+#define TWI_QUEUE_RECEIVE       4
+#define TWI_QUEUE_RECEIVE_ACK   5
+
+// What the next Timer1 tick does to the bus for a queued transaction
+#define TWI_EDGE_RESTART        0
+#define TWI_EDGE_START          1
+#define TWI_EDGE_START_HOLD     2
+#define TWI_EDGE_RISE           3
+#define TWI_EDGE_FALL           4
+#define TWI_EDGE_STOP           5
+#define TWI_EDGE_STOP_RISE      6
+#define TWI_EDGE_STOP_HOLD      7
+
+// Queued transactions take an interrupt for every edge. A half SCL period
+// of at least this many cycles leaves most of the CPU to the sketch
+#define TWI_QUEUE_MIN_TICKS     200
+
 static volatile uint8_t twi_state;
-static volatile uint8_t twi_slarw;
-static volatile uint8_t twi_sendStop;			// should the transaction end with a stop
-static volatile uint8_t twi_inRepStart;			// in the middle of a repeated start
+static volatile uint8_t twi_slaveState;
+static uint8_t twi_slaveAddress;
+static uint8_t twi_inRepStart;			// in the middle of a repeated start
+static volatile uint8_t twi_timedOut;		// a slave held SCL low too long
+
+// _delay_loop_1() counts for the low and high half of an SCL period
+static uint8_t twi_delayLow;
+static uint8_t twi_delayHigh;
 
 static void (*twi_onSlaveTransmit)(void);
 static void (*twi_onSlaveReceive)(uint8_t*, int);
 
-static uint8_t twi_masterBuffer[TWI_BUFFER_LENGTH];
-static volatile uint8_t twi_masterBufferIndex;
-static volatile uint8_t twi_masterBufferLength;
-
 static uint8_t twi_txBuffer[TWI_BUFFER_LENGTH];
 static volatile uint8_t twi_txBufferIndex;
 static volatile uint8_t twi_txBufferLength;
@@ -57,9 +110,607 @@ static volatile uint8_t twi_txBufferLength;
 static uint8_t twi_rxBuffer[TWI_BUFFER_LENGTH];
 static volatile uint8_t twi_rxBufferIndex;
 
-static volatile uint8_t twi_error;
+// Queued master transactions, clocked an edge at a time from the Timer1
+// capture interrupt
+static twi_transaction* volatile twi_queueHead;
+static twi_transaction* volatile twi_queueTail;
+static uint8_t twi_queueStep;
+static uint8_t twi_queueEdge;
+static uint8_t twi_queueStatus;		// result to hand back after the stop
+static uint8_t twi_queueIndex;			// bytes written or read so far
+static uint8_t twi_queueReading;		// past the repeated start
+static uint16_t twi_queueStretch;		// ticks SCL has been held low
+
+// Timer1 ticks in half an SCL period, and half periods in TWI_TIMEOUT
+static uint16_t twi_queueTicks;
+static uint16_t twi_queueTimeout;
+
+/*
+ * Function twi_loops
+ * Desc     converts a number of CPU cycles into a _delay_loop_1 count
+ * Input    cycles: CPU cycles to burn
+ * Output   loop count, never zero (zero would mean 256 loops)
+ */
+static uint8_t twi_loops(uint16_t cycles)
+{
+  // _delay_loop_1 takes 3 cycles per count, and the strobe itself
+  // costs roughly another 6 cycles per half period
+  cycles = cycles > 6 ? (cycles - 6) / 3 : 0;
+  if(cycles == 0){
+    return 1;
+  }
+  if(cycles > 255){
+    return 255;
+  }
+  return cycles;
+}
+
+/*
+ * Function twi_masterMode
+ * Desc     releases both lines and hands the USI to the master code
+ * Input    none
+ * Output   none
+ */
+static void twi_masterMode(void)
+{
+  TWI_PORT |= _BV(TWI_SDA) | _BV(TWI_SCL);
+  TWI_DDR |= _BV(TWI_SDA) | _BV(TWI_SCL);
+  USIDR = 0xFF;
+  USICR = TWI_USICR_MASTER;
+  USISR = TWI_USISR_8BIT;
+}
+
+/*
+ * Function twi_slaveIdle
+ * Desc     releases SDA and waits for the next start condition
+ * Input    none
+ * Output   none
+ */
+static void twi_slaveIdle(void)
+{
+  TWI_DDR &= ~_BV(TWI_SDA);
+  USICR = TWI_USICR_SLAVE_IDLE;
+  USISR = TWI_USISR_SLAVE_8BIT;
+}
+
+/*
+ * Function twi_slaveMode
+ * Desc     releases both lines and arms the start condition detector
+ * Input    none
+ * Output   none
+ */
+static void twi_slaveMode(void)
+{
+  // SCL is only ever pulled low by the USI clock hold logic
+  TWI_PORT |= _BV(TWI_SDA) | _BV(TWI_SCL);
+  TWI_DDR |= _BV(TWI_SCL);
+  TWI_DDR &= ~_BV(TWI_SDA);
+  USICR = TWI_USICR_SLAVE_IDLE;
+  USISR = TWI_USISR_8BIT;
+}
+
+/*
+ * Function twi_idle
+ * Desc     puts the USI back in its resting mode
+ * Input    none
+ * Output   none
+ */
+static void twi_idle(void)
+{
+  if(twi_slaveAddress){
+    twi_slaveMode();
+  }else{
+    twi_masterMode();
+  }
+}
+
+/*
+ * Function twi_waitScl
+ * Desc     waits for a slave stretching the clock to let go of SCL, for
+ *          at most TWI_TIMEOUT microseconds
+ * Input    none
+ * Output   nonzero if SCL is high, 0 (with twi_timedOut set) on a timeout
+ */
+static uint8_t twi_waitScl(void)
+{
+  uint16_t loops = TWI_TIMEOUT_LOOPS;
+
+  while(!(TWI_PIN & _BV(TWI_SCL))){
+    if(!--loops){
+      twi_timedOut = true;
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/*
+ * Function twi_clock
+ * Desc     clocks bits in and out of the USI data register until the
+ *          4-bit counter overflows, honouring slave clock stretching.
+ *          Does nothing once a slave has held SCL past the timeout
+ * Input    usisr: USISR value selecting a byte or a single bit
+ * Output   none
+ */
+static void twi_clock(uint8_t usisr)
+{
+  if(twi_timedOut){
+    return;
+  }
+  USISR = usisr;
+  do{
+    _delay_loop_1(twi_delayLow);
+    // rising edge, then wait for a stretching slave to let go
+    USICR = TWI_USICR_MASTER | _BV(USITC);
+    if(!twi_waitScl()){
+      return;
+    }
+    _delay_loop_1(twi_delayHigh);
+    // falling edge
+    USICR = TWI_USICR_MASTER | _BV(USITC);
+  }while(!(USISR & _BV(USIOIF)));
+  _delay_loop_1(twi_delayLow);
+}
+
+/*
+ * Function twi_transfer
+ * Desc     clocks a byte or a bit and waits for it
+ * Input    usisr: USISR value selecting a byte or a single bit
+ * Output   contents of the data register after the transfer
+ */
+static uint8_t twi_transfer(uint8_t usisr)
+{
+  uint8_t data;
+
+  twi_clock(usisr);
+
+  // read the data and release SDA
+  data = USIDR;
+  USIDR = 0xFF;
+  TWI_DDR |= _BV(TWI_SDA);
+
+  return data;
+}
+
+/*
+ * Function twi_masterStart
+ * Desc     generates a start or repeated start condition
+ * Input    none
+ * Output   nonzero if the start condition was seen on the bus
+ */
+static uint8_t twi_masterStart(void)
+{
+  // release SCL and wait for it to go high
+  TWI_PORT |= _BV(TWI_SCL);
+  if(!twi_waitScl()){
+    return 0;
+  }
+  _delay_loop_1(twi_delayHigh);
+
+  // SDA falling while SCL is high
+  TWI_PORT &= ~_BV(TWI_SDA);
+  _delay_loop_1(twi_delayHigh);
+  TWI_PORT &= ~_BV(TWI_SCL);
+  TWI_PORT |= _BV(TWI_SDA);
+
+  return USISR & _BV(USISIF);
+}
+
+/*
+ * Function twi_masterStop
+ * Desc     generates a stop condition, unless a slave is holding SCL
+ * Input    none
+ * Output   none
+ */
+static void twi_masterStop(void)
+{
+  if(twi_timedOut){
+    return;
+  }
+  // SDA rising while SCL is high
+  TWI_PORT &= ~_BV(TWI_SDA);
+  TWI_PORT |= _BV(TWI_SCL);
+  if(!twi_waitScl()){
+    return;
+  }
+  _delay_loop_1(twi_delayHigh);
+  TWI_PORT |= _BV(TWI_SDA);
+  _delay_loop_1(twi_delayLow);
+}
+
+/*
+ * Function twi_masterWrite
+ * Desc     sends one byte and reads back the acknowledge bit
+ * Input    data: byte to send
+ * Output   1 if the slave acked, 0 otherwise
+ */
+static uint8_t twi_masterWrite(uint8_t data)
+{
+  TWI_PORT &= ~_BV(TWI_SCL);
+  USIDR = data;
+  twi_transfer(TWI_USISR_8BIT);
+
+  // let go of SDA and clock in the slave's acknowledge
+  TWI_DDR &= ~_BV(TWI_SDA);
+  return !(twi_transfer(TWI_USISR_1BIT) & 0x01);
+}
+
+/*
+ * Function twi_masterRead
+ * Desc     receives one byte and answers with ack or nack
+ * Input    ack: nonzero if more bytes are to follow
+ * Output   the received byte
+ */
+static uint8_t twi_masterRead(uint8_t ack)
+{
+  uint8_t data;
+
+  TWI_DDR &= ~_BV(TWI_SDA);
+  data = twi_transfer(TWI_USISR_8BIT);
+
+  USIDR = ack ? 0x00 : 0xFF;
+  twi_transfer(TWI_USISR_1BIT);
+
+  return data;
+}
+
+/*
+ * Function twi_queueTimer
+ * Desc     starts or stops the Timer1 tick that clocks queued transactions.
+ *          Stopping it puts Timer1 back to the PWM set up by init()
+ * Input    on: nonzero to start the tick
+ * Output   none
+ */
+static void twi_queueTimer(uint8_t on)
+{
+  if(on){
+    // CTC mode with ICR1 as TOP at clk/1, which sets the capture flag
+    // every half SCL period. This disconnects OC1A and OC1B from their pins
+    TCCR1A = 0;
+    TCCR1B = _BV(WGM13) | _BV(WGM12) | _BV(CS10);
+    ICR1 = twi_queueTicks - 1;
+    TCNT1 = 0;
+    TIFR1 = _BV(ICF1);
+    TIMSK1 |= _BV(ICIE1);
+  }else{
+    TIMSK1 &= ~_BV(ICIE1);
+#if F_CPU >= 8000000L
+    TCCR1B = _BV(CS11) | _BV(CS10);
+#else
+    TCCR1B = _BV(CS11);
+#endif
+    TCCR1A = _BV(WGM10);
+  }
+}
+
+/*
+ * Function twi_queueClock
+ * Desc     sets up a byte or a bit of a queued transaction, for the next
+ *          ticks to clock
+ * Input    step: what to do once it is through
+ *          usisr: USISR value selecting a byte or a single bit
+ * Output   none
+ */
+static void twi_queueClock(uint8_t step, uint8_t usisr)
+{
+  twi_queueStep = step;
+  USISR = usisr;
+  twi_queueEdge = TWI_EDGE_RISE;
+}
+
+/*
+ * Function twi_queueSend
+ * Desc     sets up a byte of a queued transaction to be sent
+ * Input    step: TWI_QUEUE_ADDRESS or TWI_QUEUE_DATA
+ *          data: byte to send
+ * Output   none
+ */
+static void twi_queueSend(uint8_t step, uint8_t data)
+{
+  TWI_PORT &= ~_BV(TWI_SCL);
+  USIDR = data;
+  twi_queueClock(step, TWI_USISR_8BIT);
+}
+
+/*
+ * Function twi_queueReceive
+ * Desc     sets up a byte of a queued transaction to be received
+ * Input    none
+ * Output   none
+ */
+static void twi_queueReceive(void)
+{
+  TWI_DDR &= ~_BV(TWI_SDA);
+  twi_queueClock(TWI_QUEUE_RECEIVE, TWI_USISR_8BIT);
+}
+
+/*
+ * Function twi_queueDone
+ * Desc     ends the transaction at the head of the queue with a stop
+ * Input    status: twi_writeTo() style result
+ * Output   none
+ */
+static void twi_queueDone(uint8_t status)
+{
+  twi_queueStatus = status;
+  twi_queueEdge = TWI_EDGE_STOP;
+}
+
+/*
+ * Function twi_queueNext
+ * Desc     puts the next queued transaction on the bus, unless the sketch
+ *          or a slave transfer owns it. Called with interrupts off
+ * Input    none
+ * Output   none
+ */
+static void twi_queueNext(void)
+{
+  twi_transaction* transaction = twi_queueHead;
+
+  if(!transaction || TWI_READY != twi_state || twi_inRepStart){
+    return;
+  }
+  twi_state = TWI_QUEUE;
+  twi_queueIndex = 0;
+  twi_queueStretch = 0;
+  // without anything to write, go straight to the read
+  twi_queueReading = !transaction->txLength && transaction->rxLength;
+  twi_masterMode();
+  twi_queueEdge = TWI_EDGE_START;
+  if(!(TIMSK1 & _BV(ICIE1))){
+    twi_queueTimer(true);
+  }
+}
+
+/*
+ * Function twi_queueFinish
+ * Desc     hands the transaction at the head of the queue back and goes
+ *          on to the next one, or stops the tick
+ * Input    status: twi_writeTo() style result
+ * Output   none
+ */
+static void twi_queueFinish(uint8_t status)
+{
+  twi_transaction* transaction = twi_queueHead;
+
+  twi_idle();
+  twi_queueHead = transaction->next;
+  twi_state = TWI_READY;
+
+  transaction->status = status;
+  if(transaction->callback){
+    transaction->callback(transaction);
+  }
+
+  twi_queueNext();
+  if(TWI_QUEUE != twi_state){
+    twi_queueTimer(false);
+  }
+}
+
+/*
+ * Function twi_queueResume
+ * Desc     twi_queueNext() from outside an interrupt
+ * Input    none
+ * Output   none
+ */
+static void twi_queueResume(void)
+{
+  uint8_t oldSREG = SREG;
+
+  cli();
+  twi_queueNext();
+  SREG = oldSREG;
+}
 
-/* 
+/*
+ * Function twi_queueWrite
+ * Desc     sends the next byte of a queued transaction, or goes on to its
+ *          read or its end once they are all sent
+ * Input    transaction: descriptor being run
+ * Output   none
+ */
+static void twi_queueWrite(twi_transaction* transaction)
+{
+  if(twi_queueIndex < transaction->txLength){
+    twi_queueSend(TWI_QUEUE_DATA, transaction->txData[twi_queueIndex++]);
+  }else if(transaction->rxLength){
+    // repeated start, then the read
+    twi_queueIndex = 0;
+    twi_queueReading = true;
+    twi_queueEdge = TWI_EDGE_RESTART;
+  }else{
+    twi_queueDone(0);
+  }
+}
+
+/*
+ * Function twi_queueOverflow
+ * Desc     takes the step after a byte or bit of a queued transaction
+ * Input    none
+ * Output   none
+ */
+static void twi_queueOverflow(void)
+{
+  twi_transaction* transaction = twi_queueHead;
+  uint8_t data;
+
+  // read the data and release SDA, as twi_transfer() does
+  data = USIDR;
+  USIDR = 0xFF;
+  TWI_DDR |= _BV(TWI_SDA);
+
+  switch(twi_queueStep){
+    // byte sent, let go of SDA and clock in the slave's acknowledge
+    case TWI_QUEUE_ADDRESS:
+    case TWI_QUEUE_DATA:
+      TWI_DDR &= ~_BV(TWI_SDA);
+      twi_queueClock(twi_queueStep + 1, TWI_USISR_1BIT);
+      break;
+
+    case TWI_QUEUE_ADDRESS_ACK:
+      if(data & 0x01){
+        twi_queueDone(2);
+      }else if(twi_queueReading){
+        twi_queueReceive();
+      }else{
+        twi_queueWrite(transaction);
+      }
+      break;
+    case TWI_QUEUE_DATA_ACK:
+      if(data & 0x01){
+        twi_queueDone(3);
+      }else{
+        twi_queueWrite(transaction);
+      }
+      break;
+
+    // byte received, ack all but the last one
+    case TWI_QUEUE_RECEIVE:
+      transaction->rxData[twi_queueIndex++] = data;
+      USIDR = twi_queueIndex < transaction->rxLength ? 0x00 : 0xFF;
+      twi_queueClock(TWI_QUEUE_RECEIVE_ACK, TWI_USISR_1BIT);
+      break;
+    case TWI_QUEUE_RECEIVE_ACK:
+      if(twi_queueIndex < transaction->rxLength){
+        twi_queueReceive();
+      }else{
+        twi_queueDone(0);
+      }
+      break;
+  }
+}
+
+/*
+ * Function twi_queueTick
+ * Desc     makes the next SCL or SDA edge of a queued transaction, every
+ *          half SCL period. While a slave stretches the clock the edge
+ *          after SCL is released waits for it, up to TWI_TIMEOUT
+ * Input    none
+ * Output   none
+ */
+static void twi_queueTick(void)
+{
+  switch(twi_queueEdge){
+    case TWI_EDGE_START:
+    case TWI_EDGE_FALL:
+    case TWI_EDGE_STOP_HOLD:
+      if(!(TWI_PIN & _BV(TWI_SCL))){
+        if(++twi_queueStretch >= twi_queueTimeout){
+          // let go of the bus without a stop
+          twi_queueFinish(5);
+        }
+        return;
+      }
+      twi_queueStretch = 0;
+      break;
+  }
+
+  switch(twi_queueEdge){
+    // repeated start: SDA is released, release SCL
+    case TWI_EDGE_RESTART:
+      TWI_PORT |= _BV(TWI_SCL);
+      twi_queueEdge = TWI_EDGE_START;
+      break;
+    // SDA falling while SCL is high, then SCL low and the address
+    case TWI_EDGE_START:
+      TWI_PORT &= ~_BV(TWI_SDA);
+      twi_queueEdge = TWI_EDGE_START_HOLD;
+      break;
+    case TWI_EDGE_START_HOLD:
+      TWI_PORT &= ~_BV(TWI_SCL);
+      TWI_PORT |= _BV(TWI_SDA);
+      if(!(USISR & _BV(USISIF))){
+        twi_queueDone(4);
+        break;
+      }
+      twi_queueSend(TWI_QUEUE_ADDRESS,
+                    (twi_queueReading ? TW_READ : TW_WRITE) | (twi_queueHead->address << 1));
+      break;
+
+    // one bit: SCL released, then low again. The step after a byte or bit
+    // is taken once the counter overflows
+    case TWI_EDGE_RISE:
+      USICR = TWI_USICR_MASTER | _BV(USITC);
+      twi_queueEdge = TWI_EDGE_FALL;
+      break;
+    case TWI_EDGE_FALL:
+      USICR = TWI_USICR_MASTER | _BV(USITC);
+      if(USISR & _BV(USIOIF)){
+        twi_queueOverflow();
+      }else{
+        twi_queueEdge = TWI_EDGE_RISE;
+      }
+      break;
+
+    // SDA rising while SCL is high
+    case TWI_EDGE_STOP:
+      TWI_PORT &= ~_BV(TWI_SDA);
+      twi_queueEdge = TWI_EDGE_STOP_RISE;
+      break;
+    case TWI_EDGE_STOP_RISE:
+      TWI_PORT |= _BV(TWI_SCL);
+      twi_queueEdge = TWI_EDGE_STOP_HOLD;
+      break;
+    case TWI_EDGE_STOP_HOLD:
+      TWI_PORT |= _BV(TWI_SDA);
+      twi_queueFinish(twi_queueStatus);
+      break;
+  }
+}
+
+/*
+ * Function twi_masterBegin
+ * Desc     waits for any slave transaction to finish and takes the bus
+ * Input    state: TWI_MRX or TWI_MTX
+ * Output   nonzero if the start condition was put on the bus
+ */
+static uint8_t twi_masterBegin(uint8_t state)
+{
+  uint8_t oldSREG;
+
+  // wait until twi is ready, then claim it before the start ISR can
+  for(;;){
+    oldSREG = SREG;
+    cli();
+    if(TWI_READY == twi_state){
+      break;
+    }
+    SREG = oldSREG;
+  }
+  twi_state = state;
+  twi_timedOut = false;
+  // a repeated start leaves the USI in master mode with SCL held low
+  if(!twi_inRepStart){
+    twi_masterMode();
+  }
+  SREG = oldSREG;
+
+  twi_inRepStart = false;
+  return twi_masterStart();
+}
+
+/*
+ * Function twi_masterEnd
+ * Desc     finishes a master transaction
+ * Input    sendStop: boolean indicating whether to send a stop or keep
+ *          the bus for a repeated start. After a timeout the USI lets go
+ *          of the bus without one
+ * Output   none
+ */
+static void twi_masterEnd(uint8_t sendStop)
+{
+  if(sendStop || twi_timedOut){
+    twi_masterStop();
+    twi_idle();
+  }else{
+    twi_inRepStart = true;
+  }
+  twi_state = TWI_READY;
+  twi_queueResume();
+}
+
+/*
  * Function twi_init
  * Desc     readys twi pins and sets twi bitrate
  * Input    none
@@ -69,28 +720,13 @@ void twi_init(void)
 {
   // initialize state
   twi_state = TWI_READY;
-  twi_sendStop = true;		// default value
   twi_inRepStart = false;
-  
-  // activate internal pullups for twi.
-  digitalWrite(SDA, 1);
-  digitalWrite(SCL, 1);
-
-  // initialize twi prescaler and bit rate
-  cbi(TWSR, TWPS0);
-  cbi(TWSR, TWPS1);
-  TWBR = ((F_CPU / TWI_FREQ) - 16) / 2;
 
-  /* twi bit rate formula from atmega128 manual pg 204
-  SCL Frequency = CPU Clock Frequency / (16 + (2 * TWBR))
-  note: TWBR should be 10 or higher for master mode
-  It is 72 for a 16mhz Wiring board with 100kHz TWI */
-
-  // enable twi module, acks, and twi interrupt
-  TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA);
+  twi_setFrequency(TWI_FREQ);
+  twi_idle();
 }
 
-/* 
+/*
  * Function twi_disable
  * Desc     disables twi pins
  * Input    none
@@ -98,27 +734,48 @@ void twi_init(void)
  */
 void twi_disable(void)
 {
-  // disable twi module, acks, and twi interrupt
-  TWCR &= ~(_BV(TWEN) | _BV(TWIE) | _BV(TWEA));
+  // disable the USI and its interrupts
+  USICR = 0;
+  TWI_DDR &= ~(_BV(TWI_SDA) | _BV(TWI_SCL));
 
   // deactivate internal pullups for twi.
   digitalWrite(SDA, 0);
   digitalWrite(SCL, 0);
 }
 
-/* 
- * Function twi_slaveInit
- * Desc     sets slave address and enables interrupt
- * Input    none
+/*
+ * Function twi_setAddress
+ * Desc     sets slave address, takes effect on twi_init
+ * Input    address: 7bit slave address, 0 for master only
  * Output   none
  */
 void twi_setAddress(uint8_t address)
 {
-  // set twi slave address (skip over TWGCE bit)
-  TWAR = address << 1;
+  twi_slaveAddress = address;
+}
+
+/*
+ * Function twi_setFrequency
+ * Desc     sets the master SCL frequency
+ * Input    frequency: SCL frequency in Hz
+ * Output   none
+ */
+void twi_setFrequency(uint32_t frequency)
+{
+  uint16_t period = F_CPU / frequency;
+
+  // The I2C spec wants a longer low than high phase (4.7/4.0us in standard
+  // and 1.3/0.6us in fast mode), so give the low phase 9/16 of the period
+  twi_delayLow = twi_loops((uint32_t)period * 9 / 16);
+  twi_delayHigh = twi_loops(period - (uint32_t)period * 9 / 16);
+
+  // Timer1 runs at clk/1 for queued transactions
+  period /= 2;
+  twi_queueTicks = period < TWI_QUEUE_MIN_TICKS ? TWI_QUEUE_MIN_TICKS : period;
+  twi_queueTimeout = (F_CPU / 1000000L) * TWI_TIMEOUT / twi_queueTicks;
 }
 
-/* 
+/*
  * Function twi_readFrom
  * Desc     attempts to become twi bus master and read a
  *          series of bytes from a device on the bus
@@ -126,154 +783,110 @@ void twi_setAddress(uint8_t address)
  *          data: pointer to byte array
  *          length: number of bytes to read into array
  *          sendStop: Boolean indicating whether to send a stop at the end
- * Output   number of bytes read
+ * Output   number of bytes read, 0 on an error or timeout
  */
 uint8_t twi_readFrom(uint8_t address, uint8_t* data, uint8_t length, uint8_t sendStop)
 {
   uint8_t i;
 
-  // ensure data will fit into buffer
-  if(TWI_BUFFER_LENGTH < length){
+  if(0 == length){
     return 0;
   }
 
-  // wait until twi is ready, become master receiver
-  while(TWI_READY != twi_state){
-    continue;
-  }
-  twi_state = TWI_MRX;
-  twi_sendStop = sendStop;
-  // reset error state (0xFF.. no error occured)
-  twi_error = 0xFF;
-
-  // initialize buffer iteration vars
-  twi_masterBufferIndex = 0;
-  twi_masterBufferLength = length-1;  // This is not intuitive, read on...
-  // On receive, the previously configured ACK/NACK setting is transmitted in
-  // response to the received byte before the interrupt is signalled. 
-  // Therefor we must actually set NACK when the _next_ to last byte is
-  // received, causing that NACK to be sent in response to receiving the last
-  // expected byte of data.
-
-  // build sla+w, slave device address + w bit
-  twi_slarw = TW_READ;
-  twi_slarw |= address << 1;
-
-  if (true == twi_inRepStart) {
-    // if we're in the repeated start state, then we've already sent the start,
-    // (@@@ we hope), and the TWI statemachine is just waiting for the address byte.
-    // We need to remove ourselves from the repeated start state before we enable interrupts,
-    // since the ISR is ASYNC, and we could get confused if we hit the ISR before cleaning
-    // up. Also, don't enable the START interrupt. There may be one pending from the 
-    // repeated start that we sent ourselves, and that would really confuse things.
-    twi_inRepStart = false;			// remember, we're dealing with an ASYNC ISR
-    do {
-      TWDR = twi_slarw;
-    } while(TWCR & _BV(TWWC));
-    TWCR = _BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE);	// enable INTs, but not START
-  }
-  else
-    // send start condition
-    TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA) | _BV(TWINT) | _BV(TWSTA);
-
-  // wait for read operation to complete
-  while(TWI_MRX == twi_state){
-    continue;
+  // bytes go straight into the caller's array, nack the last one
+  if(!twi_masterBegin(TWI_MRX) || !twi_masterWrite(TW_READ | (address << 1))){
+    twi_masterEnd(true);
+    return 0;
   }
-
-  if (twi_masterBufferIndex < length)
-    length = twi_masterBufferIndex;
-
-  // copy twi buffer to data
   for(i = 0; i < length; ++i){
-    data[i] = twi_masterBuffer[i];
+    data[i] = twi_masterRead(i + 1 < length);
+  }
+  if(twi_timedOut){
+    length = 0;
   }
-	
+  twi_masterEnd(sendStop);
+
   return length;
 }
 
-/* 
+/*
  * Function twi_writeTo
  * Desc     attempts to become twi bus master and write a
  *          series of bytes to a device on the bus
  * Input    address: 7bit i2c device address
  *          data: pointer to byte array
  *          length: number of bytes in array
- *          wait: boolean indicating to wait for write or not
+ *          wait: unused, the USI master always finishes before returning
  *          sendStop: boolean indicating whether or not to send a stop at the end
  * Output   0 .. success
- *          1 .. length to long for buffer
  *          2 .. address send, NACK received
  *          3 .. data send, NACK received
- *          4 .. other twi error (lost bus arbitration, bus error, ..)
+ *          4 .. other twi error (missing start condition)
+ *          5 .. timeout, a slave held SCL low for TWI_TIMEOUT
  */
 uint8_t twi_writeTo(uint8_t address, uint8_t* data, uint8_t length, uint8_t wait, uint8_t sendStop)
 {
   uint8_t i;
+  uint8_t error = 0;
 
-  // ensure data will fit into buffer
-  if(TWI_BUFFER_LENGTH < length){
-    return 1;
-  }
+  (void)wait;
 
-  // wait until twi is ready, become master transmitter
-  while(TWI_READY != twi_state){
-    continue;
+  if(!twi_masterBegin(TWI_MTX)){
+    error = 4;
+  }else if(!twi_masterWrite(TW_WRITE | (address << 1))){
+    error = 2;
+  }else{
+    for(i = 0; i < length; ++i){
+      if(!twi_masterWrite(data[i])){
+        error = 3;
+        break;
+      }
+    }
+  }
+  if(twi_timedOut){
+    error = 5;
   }
-  twi_state = TWI_MTX;
-  twi_sendStop = sendStop;
-  // reset error state (0xFF.. no error occured)
-  twi_error = 0xFF;
 
-  // initialize buffer iteration vars
-  twi_masterBufferIndex = 0;
-  twi_masterBufferLength = length;
-  
-  // copy data to twi buffer
-  for(i = 0; i < length; ++i){
-    twi_masterBuffer[i] = data[i];
-  }
-  
-  // build sla+w, slave device address + w bit
-  twi_slarw = TW_WRITE;
-  twi_slarw |= address << 1;
-  
-  // if we're in a repeated start, then we've already sent the START
-  // in the ISR. Don't do it again.
-  //
-  if (true == twi_inRepStart) {
-    // if we're in the repeated start state, then we've already sent the start,
-    // (@@@ we hope), and the TWI statemachine is just waiting for the address byte.
-    // We need to remove ourselves from the repeated start state before we enable interrupts,
-    // since the ISR is ASYNC, and we could get confused if we hit the ISR before cleaning
-    // up. Also, don't enable the START interrupt. There may be one pending from the 
-    // repeated start that we sent outselves, and that would really confuse things.
-    twi_inRepStart = false;			// remember, we're dealing with an ASYNC ISR
-    do {
-      TWDR = twi_slarw;				
-    } while(TWCR & _BV(TWWC));
-    TWCR = _BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE);	// enable INTs, but not START
-  }
-  else
-    // send start condition
-    TWCR = _BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE) | _BV(TWSTA);	// enable INTs
-
-  // wait for write operation to complete
-  while(wait && (TWI_MTX == twi_state)){
-    continue;
+  // a failed transfer always releases the bus
+  twi_masterEnd(sendStop || error);
+
+  return error;
+}
+
+/*
+ * Function twi_submit
+ * Desc     queues a master transaction to be run in the background. A
+ *          Timer1 interrupt makes one SCL or SDA edge every half period,
+ *          so the sketch runs in between; nothing waits for the bus. The
+ *          clock is at most F_CPU / 400, 40 kHz at 16 MHz, to keep the
+ *          interrupts from taking up the CPU. Timer1 is taken over while
+ *          the queue runs, so analogWrite() on pins 13 and 14, Servo,
+ *          tone() and Timer::useInterrupt() can't be used alongside.
+ *          A transaction held up by a slave transfer starts after its stop
+ * Input    transaction: descriptor, owned by the caller until its
+ *          callback has run (or its status is no longer TWI_PENDING)
+ * Output   none
+ */
+void twi_submit(twi_transaction* transaction)
+{
+  uint8_t oldSREG;
+
+  transaction->status = TWI_PENDING;
+  transaction->next = NULL;
+
+  oldSREG = SREG;
+  cli();
+  if(twi_queueHead){
+    twi_queueTail->next = transaction;
+  }else{
+    twi_queueHead = transaction;
   }
-  
-  if (twi_error == 0xFF)
-    return 0;	// success
-  else if (twi_error == TW_MT_SLA_NACK)
-    return 2;	// error: address send, nack received
-  else if (twi_error == TW_MT_DATA_NACK)
-    return 3;	// error: data send, nack received
-  else
-    return 4;	// other twi error
+  twi_queueTail = transaction;
+  twi_queueNext();
+  SREG = oldSREG;
 }
 
-/* 
+/*
  * Function twi_transmit
  * Desc     fills slave tx buffer with data
  *          must be called in slave tx event callback
@@ -291,22 +904,22 @@ uint8_t twi_transmit(const uint8_t* data, uint8_t length)
   if(TWI_BUFFER_LENGTH < length){
     return 1;
   }
-  
+
   // ensure we are currently a slave transmitter
   if(TWI_STX != twi_state){
     return 2;
   }
-  
+
   // set length and copy data into tx buffer
   twi_txBufferLength = length;
   for(i = 0; i < length; ++i){
     twi_txBuffer[i] = data[i];
   }
-  
+
   return 0;
 }
 
-/* 
+/*
  * Function twi_attachSlaveRxEvent
  * Desc     sets function called before a slave read operation
  * Input    function: callback function to use
@@ -317,7 +930,7 @@ void twi_attachSlaveRxEvent( void (*function)(uint8_t*, int) )
   twi_onSlaveReceive = function;
 }
 
-/* 
+/*
  * Function twi_attachSlaveTxEvent
  * Desc     sets function called before a slave write operation
  * Input    function: callback function to use
@@ -328,23 +941,25 @@ void twi_attachSlaveTxEvent( void (*function)(void) )
   twi_onSlaveTransmit = function;
 }
 
-/* 
+/*
  * Function twi_reply
- * Desc     sends byte or readys receive line
+ * Desc     clocks out the slave acknowledge bit
  * Input    ack: byte indicating to ack or to nack
  * Output   none
  */
 void twi_reply(uint8_t ack)
 {
-  // transmit master read ready signal, with or without ack
   if(ack){
-    TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT) | _BV(TWEA);
+    USIDR = 0x00;
+    TWI_DDR |= _BV(TWI_SDA);
   }else{
-	  TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT);
+    TWI_DDR &= ~_BV(TWI_SDA);
   }
+  // releases SCL and counts the acknowledge bit
+  USISR = TWI_USISR_SLAVE_1BIT;
 }
 
-/* 
+/*
  * Function twi_stop
  * Desc     relinquishes bus master status
  * Input    none
@@ -352,20 +967,17 @@ void twi_reply(uint8_t ack)
  */
 void twi_stop(void)
 {
-  // send stop condition
-  TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA) | _BV(TWINT) | _BV(TWSTO);
-
-  // wait for stop condition to be exectued on bus
-  // TWINT is not set after a stop condition!
-  while(TWCR & _BV(TWSTO)){
-    continue;
-  }
+  twi_timedOut = false;
+  twi_masterStop();
+  twi_inRepStart = false;
+  twi_idle();
 
   // update twi state
   twi_state = TWI_READY;
+  twi_queueResume();
 }
 
-/* 
+/*
  * Function twi_releaseBus
  * Desc     releases bus control
  * Input    none
@@ -373,173 +985,177 @@ void twi_stop(void)
  */
 void twi_releaseBus(void)
 {
-  // release bus
-  TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA) | _BV(TWINT);
+  twi_inRepStart = false;
+  twi_idle();
 
   // update twi state
   twi_state = TWI_READY;
+  twi_queueResume();
 }
 
-ISR(TWI_vect)
+/*
+ * Function twi_slaveReceived
+ * Desc     hands a finished slave receive transaction to the user
+ * Input    none
+ * Output   none
+ */
+static void twi_slaveReceived(void)
 {
-  switch(TW_STATUS){
-    // All Master
-    case TW_START:     // sent start condition
-    case TW_REP_START: // sent repeated start condition
-      // copy device address and r/w bit to output register and ack
-      TWDR = twi_slarw;
-      twi_reply(1);
-      break;
+  // put a null char after data if there's room
+  if(twi_rxBufferIndex < TWI_BUFFER_LENGTH){
+    twi_rxBuffer[twi_rxBufferIndex] = '\0';
+  }
+  // callback to user defined callback
+  twi_onSlaveReceive(twi_rxBuffer, twi_rxBufferIndex);
+  // since we submit rx buffer to "wire" library, we can reset it
+  twi_rxBufferIndex = 0;
+}
 
-    // Master Transmitter
-    case TW_MT_SLA_ACK:  // slave receiver acked address
-    case TW_MT_DATA_ACK: // slave receiver acked data
-      // if there is data to send, send it, otherwise stop 
-      if(twi_masterBufferIndex < twi_masterBufferLength){
-        // copy data to output register and ack
-        TWDR = twi_masterBuffer[twi_masterBufferIndex++];
-        twi_reply(1);
+ISR(USI_START_vect)
+{
+  uint16_t loops = TWI_TIMEOUT_LOOPS;
+
+  // a repeated start ends a slave receive just like a stop does
+  if(TWI_SRX == twi_state){
+    twi_slaveReceived();
+  }
+  twi_state = TWI_READY;
+  twi_slaveState = TWI_SLAVE_CHECK_ADDRESS;
+  TWI_DDR &= ~_BV(TWI_SDA);
+
+  // wait for the master to pull SCL low, which completes the start
+  // condition, or for SDA to go high again, which makes it a stop
+  while((TWI_PIN & _BV(TWI_SCL)) && !(TWI_PIN & _BV(TWI_SDA)) && --loops){
+    continue;
+  }
+  if(TWI_PIN & _BV(TWI_SDA)){
+    USICR = TWI_USICR_SLAVE_IDLE;
+  }else{
+    USICR = TWI_USICR_SLAVE_ACTIVE;
+  }
+  // clear the start flag (releasing SCL) and count the address byte
+  USISR = TWI_USISR_8BIT;
+}
+
+ISR(TIMER1_CAPT_vect)
+{
+  twi_queueTick();
+}
+
+ISR(USI_OVERFLOW_vect)
+{
+  uint16_t loops = TWI_TIMEOUT_LOOPS;
+
+  switch(twi_slaveState){
+    // Address byte received
+    case TWI_SLAVE_CHECK_ADDRESS:
+      if((USIDR >> 1) != twi_slaveAddress){
+        twi_slaveIdle();
+        break;
+      }
+      if(USIDR & TW_READ){
+        // enter slave transmitter mode
+        twi_state = TWI_STX;
+        // ready the tx buffer index for iteration
+        twi_txBufferIndex = 0;
+        // set tx buffer length to be zero, to verify if user changes it
+        twi_txBufferLength = 0;
+        // request for txBuffer to be filled and length to be set
+        // note: user must call twi_transmit(bytes, length) to do this
+        twi_onSlaveTransmit();
+        // if they didn't change buffer & length, initialize it
+        if(0 == twi_txBufferLength){
+          twi_txBufferLength = 1;
+          twi_txBuffer[0] = 0x00;
+        }
+        twi_slaveState = TWI_SLAVE_SEND_DATA;
       }else{
-	if (twi_sendStop)
-          twi_stop();
-	else {
-	  twi_inRepStart = true;	// we're gonna send the START
-	  // don't enable the interrupt. We'll generate the start, but we 
-	  // avoid handling the interrupt until we're in the next transaction,
-	  // at the point where we would normally issue the start.
-	  TWCR = _BV(TWINT) | _BV(TWSTA)| _BV(TWEN) ;
-	  twi_state = TWI_READY;
-	}
+        // enter slave receiver mode
+        twi_state = TWI_SRX;
+        // indicate that rx buffer can be overwritten
+        twi_rxBufferIndex = 0;
+        twi_slaveState = TWI_SLAVE_REQUEST_DATA;
       }
-      break;
-    case TW_MT_SLA_NACK:  // address sent, nack received
-      twi_error = TW_MT_SLA_NACK;
-      twi_stop();
-      break;
-    case TW_MT_DATA_NACK: // data sent, nack received
-      twi_error = TW_MT_DATA_NACK;
-      twi_stop();
-      break;
-    case TW_MT_ARB_LOST: // lost bus arbitration
-      twi_error = TW_MT_ARB_LOST;
-      twi_releaseBus();
+      twi_reply(1);
       break;
 
-    // Master Receiver
-    case TW_MR_DATA_ACK: // data received, ack sent
-      // put byte into buffer
-      twi_masterBuffer[twi_masterBufferIndex++] = TWDR;
-    case TW_MR_SLA_ACK:  // address sent, ack received
-      // ack if more bytes are expected, otherwise nack
-      if(twi_masterBufferIndex < twi_masterBufferLength){
-        twi_reply(1);
+    // Slave Transmitter
+    case TWI_SLAVE_CHECK_REPLY:
+      if(USIDR & 0x01){
+        // received nack, we are done. The master ends with a stop or a
+        // repeated start within a bit time, and after a stop the queue
+        // can have the bus. A master that does neither by the timeout
+        // leaves the bus to the start detector
+        twi_state = TWI_READY;
+        twi_slaveIdle();
+        while(!(USISR & (_BV(USIPF) | _BV(USISIF))) && --loops){
+          continue;
+        }
+        if(USISR & _BV(USIPF)){
+          twi_queueNext();
+        }
+        break;
+      }
+      // received ack, transmit next byte, fall
+    case TWI_SLAVE_SEND_DATA:
+      if(twi_txBufferIndex < twi_txBufferLength){
+        USIDR = twi_txBuffer[twi_txBufferIndex++];
       }else{
-        twi_reply(0);
+        USIDR = 0xFF;
       }
+      TWI_DDR |= _BV(TWI_SDA);
+      USISR = TWI_USISR_SLAVE_8BIT;
+      twi_slaveState = TWI_SLAVE_REQUEST_REPLY;
       break;
-    case TW_MR_DATA_NACK: // data received, nack sent
-      // put final byte into buffer
-      twi_masterBuffer[twi_masterBufferIndex++] = TWDR;
-	if (twi_sendStop)
-          twi_stop();
-	else {
-	  twi_inRepStart = true;	// we're gonna send the START
-	  // don't enable the interrupt. We'll generate the start, but we 
-	  // avoid handling the interrupt until we're in the next transaction,
-	  // at the point where we would normally issue the start.
-	  TWCR = _BV(TWINT) | _BV(TWSTA)| _BV(TWEN) ;
-	  twi_state = TWI_READY;
-	}    
-	break;
-    case TW_MR_SLA_NACK: // address sent, nack received
-      twi_stop();
+    case TWI_SLAVE_REQUEST_REPLY:
+      // byte sent, release SDA and read the master's ack
+      TWI_DDR &= ~_BV(TWI_SDA);
+      USIDR = 0;
+      USISR = TWI_USISR_SLAVE_1BIT;
+      twi_slaveState = TWI_SLAVE_CHECK_REPLY;
       break;
-    // TW_MR_ARB_LOST handled by TW_MT_ARB_LOST case
 
     // Slave Receiver
-    case TW_SR_SLA_ACK:   // addressed, returned ack
-    case TW_SR_GCALL_ACK: // addressed generally, returned ack
-    case TW_SR_ARB_LOST_SLA_ACK:   // lost arbitration, returned ack
-    case TW_SR_ARB_LOST_GCALL_ACK: // lost arbitration, returned ack
-      // enter slave receiver mode
-      twi_state = TWI_SRX;
-      // indicate that rx buffer can be overwritten and ack
-      twi_rxBufferIndex = 0;
-      twi_reply(1);
+    case TWI_SLAVE_REQUEST_DATA:
+      // ack sent, release SDA and interrupt on the next rising SCL edge.
+      // The USI has no stop interrupt, so this is where a stop is caught
+      TWI_DDR &= ~_BV(TWI_SDA);
+      USISR = TWI_USISR_SLAVE_1EDGE;
+      twi_slaveState = TWI_SLAVE_DATA_EDGE;
       break;
-    case TW_SR_DATA_ACK:       // data received, returned ack
-    case TW_SR_GCALL_DATA_ACK: // data received generally, returned ack
-      // if there is still room in the rx buffer
-      if(twi_rxBufferIndex < TWI_BUFFER_LENGTH){
-        // put byte in buffer and ack
-        twi_rxBuffer[twi_rxBufferIndex++] = TWDR;
-        twi_reply(1);
+    case TWI_SLAVE_DATA_EDGE:
+      // A data bit keeps SDA steady until SCL falls again, while a stop or
+      // repeated start toggles SDA with SCL high. At most half a bit time
+      while((TWI_PIN & _BV(TWI_SCL)) && !(USISR & (_BV(USIPF) | _BV(USISIF))) && --loops){
+        continue;
+      }
+      if(USISR & _BV(USIPF)){
+        // stop condition received
+        twi_state = TWI_READY;
+        twi_slaveReceived();
+        twi_slaveIdle();
+        twi_queueNext();
+      }else if(USISR & _BV(USISIF)){
+        // repeated start, USI_START_vect takes it from here
+        USISR = _BV(USIOIF);
       }else{
-        // otherwise nack
-        twi_reply(0);
+        // first bit is in, its rising and falling edges are past: preload
+        // the counter so it overflows after the other 14
+        USISR = _BV(USIOIF) | ((16 - 14) << USICNT0);
+        twi_slaveState = TWI_SLAVE_GET_DATA;
       }
       break;
-    case TW_SR_STOP: // stop or repeated start condition received
-      // ack future responses and leave slave receiver state
-      twi_releaseBus();
-      // put a null char after data if there's room
+    case TWI_SLAVE_GET_DATA:
+      // if there is still room in the rx buffer
+      twi_slaveState = TWI_SLAVE_REQUEST_DATA;
       if(twi_rxBufferIndex < TWI_BUFFER_LENGTH){
-        twi_rxBuffer[twi_rxBufferIndex] = '\0';
-      }
-      // callback to user defined callback
-      twi_onSlaveReceive(twi_rxBuffer, twi_rxBufferIndex);
-      // since we submit rx buffer to "wire" library, we can reset it
-      twi_rxBufferIndex = 0;
-      break;
-    case TW_SR_DATA_NACK:       // data received, returned nack
-    case TW_SR_GCALL_DATA_NACK: // data received generally, returned nack
-      // nack back at master
-      twi_reply(0);
-      break;
-    
-    // Slave Transmitter
-    case TW_ST_SLA_ACK:          // addressed, returned ack
-    case TW_ST_ARB_LOST_SLA_ACK: // arbitration lost, returned ack
-      // enter slave transmitter mode
-      twi_state = TWI_STX;
-      // ready the tx buffer index for iteration
-      twi_txBufferIndex = 0;
-      // set tx buffer length to be zero, to verify if user changes it
-      twi_txBufferLength = 0;
-      // request for txBuffer to be filled and length to be set
-      // note: user must call twi_transmit(bytes, length) to do this
-      twi_onSlaveTransmit();
-      // if they didn't change buffer & length, initialize it
-      if(0 == twi_txBufferLength){
-        twi_txBufferLength = 1;
-        twi_txBuffer[0] = 0x00;
-      }
-      // transmit first byte from buffer, fall
-    case TW_ST_DATA_ACK: // byte sent, ack returned
-      // copy data to output register
-      TWDR = twi_txBuffer[twi_txBufferIndex++];
-      // if there is more to send, ack, otherwise nack
-      if(twi_txBufferIndex < twi_txBufferLength){
+        // put byte in buffer and ack
+        twi_rxBuffer[twi_rxBufferIndex++] = USIDR;
         twi_reply(1);
       }else{
+        // otherwise nack
         twi_reply(0);
       }
       break;
-    case TW_ST_DATA_NACK: // received nack, we are done 
-    case TW_ST_LAST_DATA: // received ack, but we are done already!
-      // ack future responses
-      twi_reply(1);
-      // leave slave receiver state
-      twi_state = TWI_READY;
-      break;
-
-    // All
-    case TW_NO_INFO:   // no state information
-      break;
-    case TW_BUS_ERROR: // bus error, illegal stop/start
-      twi_error = TW_BUS_ERROR;
-      twi_stop();
-      break;
   }
 }
-
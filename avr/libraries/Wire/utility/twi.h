@@ -28,6 +28,11 @@
   #define TWI_FREQ 100000L
   #endif
 
+  // microseconds a slave may hold SCL low before the master gives up
+  #ifndef TWI_TIMEOUT
+  #define TWI_TIMEOUT 25000L
+  #endif
+
   #ifndef TWI_BUFFER_LENGTH
   #define TWI_BUFFER_LENGTH 32
   #endif
@@ -37,10 +42,29 @@
   #define TWI_MTX   2
   #define TWI_SRX   3
   #define TWI_STX   4
-  
+  #define TWI_QUEUE 5   // running a queued transaction
+
+  // status of a queued transaction that has not run yet
+  #define TWI_PENDING 0xFF
+
+  // Queued master transaction: writes txData, then reads rxData after a
+  // repeated start. Both buffers belong to the caller and must stay valid
+  // until the callback runs. status holds a twi_writeTo() result when done
+  typedef struct twi_transaction {
+    uint8_t address;
+    const uint8_t *txData;
+    uint8_t txLength;
+    uint8_t *rxData;
+    uint8_t rxLength;
+    void (*callback)(struct twi_transaction*);
+    volatile uint8_t status;
+    struct twi_transaction *next;
+  } twi_transaction;
+
   void twi_init(void);
   void twi_disable(void);
   void twi_setAddress(uint8_t);
+  void twi_setFrequency(uint32_t);
   uint8_t twi_readFrom(uint8_t, uint8_t*, uint8_t, uint8_t);
   uint8_t twi_writeTo(uint8_t, uint8_t*, uint8_t, uint8_t, uint8_t);
   uint8_t twi_transmit(const uint8_t*, uint8_t);
@@ -49,6 +73,7 @@
   void twi_reply(uint8_t);
   void twi_stop(void);
   void twi_releaseBus(void);
+  void twi_submit(twi_transaction*);
 
 #endif
 
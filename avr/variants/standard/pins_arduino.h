@@ -41,7 +41,14 @@
 #define NUM_ANALOG_INPUTS           8
 #define analogInputToDigitalPin(p) (((p) < 8) ? (p) + 45 : -1)
 #define digitalPinHasPWM(p)        (((p) >= 3 && (p) <= 5) || ((p) >= 12 && (p) <= 15))
-#define digitalPinToInterrupt(p)   ((p) == 15 ? 0 : NOT_AN_INTERRUPT)
+#define digitalPinToInterrupt(p)   ((p) == 19 ? 0 : NOT_AN_INTERRUPT)
+
+// PCINT0-7 are on port E (D0-D7) and PCINT8-15 on port B (D8-D15). Their
+// enable bits are in EIMSK rather than a PCICR
+#define digitalPinToPCICR(p)       (((p) <= 15) ? (&EIMSK) : ((uint8_t *)0))
+#define digitalPinToPCICRbit(p)    (((p) <= 7) ? PCIE0 : PCIE1)
+#define digitalPinToPCMSK(p)       (((p) <= 7) ? (&PCMSK0) : (((p) <= 15) ? (&PCMSK1) : ((uint8_t *)0)))
+#define digitalPinToPCMSKbit(p)    ((p) & 7)
 
 static const uint8_t SS   = 8;
 static const uint8_t SCK  = 9;
@@ -52,8 +59,8 @@ static const uint8_t MISO = 11;
 #define BUZZER 13
 #define LIGHT_SENSOR 47 // LDR connected to A0
 
-static const uint8_t SDA = 18;
-static const uint8_t SCL = 19;
+static const uint8_t SDA = 5;
+static const uint8_t SCL = 4;
 
 static const uint8_t A0 = 45;
 static const uint8_t A1 = 46;
@@ -106,8 +113,8 @@ const uint8_t PROGMEM digital_pin_to_port_PGM[] = {
 	PE, // PE1 ** D1 ** TX0	
 	PE, // PE2 ** D2
 	PE, // PE3 ** D3 ** PWM
-	PE, // PE4 ** D4 ** PWM	
-	PE, // PE5 ** D5 ** PWM
+	PE, // PE4 ** D4 ** SCL	
+	PE, // PE5 ** D5 ** SDA
 	PE, // PE6 ** D6 
 	PE, // PE7 ** D7
 	
@@ -123,8 +130,8 @@ const uint8_t PROGMEM digital_pin_to_port_PGM[] = {
 	PG, // PG3 ** D16
 	PG, // PG4 ** D17
 	
-	PD, // PD0 ** D18 ** SCL	
-	PD, // PD1 ** D19 ** SDA	
+	PD, // PD0 ** D18	
+	PD, // PD1 ** D19	
 	PD, // PD2 ** D20 ** RX1
 	PD, // PD3 ** D21 ** TX1	
 	PD, // PD4 ** D22 
@@ -170,8 +177,8 @@ const uint8_t PROGMEM digital_pin_to_bit_mask_PGM[] = {
 	_BV(1), // PE1 ** D1 ** TX0	
 	_BV(2), // PE2 ** D2
 	_BV(3), // PE3 ** D3 ** PWM
-	_BV(4), // PE4 ** D4 ** PWM	
-	_BV(5), // PE5 ** D5 ** PWM
+	_BV(4), // PE4 ** D4 ** SCL	
+	_BV(5), // PE5 ** D5 ** SDA
 	_BV(6), // PE6 ** D6 
 	_BV(7), // PE7 ** D7
 	
@@ -187,8 +194,8 @@ const uint8_t PROGMEM digital_pin_to_bit_mask_PGM[] = {
 	_BV(3), // PG3 ** D16
 	_BV(4), // PG4 ** D17
 	
-	_BV(0), // PD0 ** D18 ** SCL	
-	_BV(1), // PD1 ** D19 ** SDA	
+	_BV(0), // PD0 ** D18	
+	_BV(1), // PD1 ** D19	
 	_BV(2), // PD2 ** D20 ** RX1
 	_BV(3), // PD3 ** D21 ** TX1	
 	_BV(4), // PD4 ** D22 
@@ -234,8 +241,8 @@ const uint8_t PROGMEM digital_pin_to_timer_PGM[] = {
 	NOT_ON_TIMER, // PE1 ** D1 ** TX0	
 	NOT_ON_TIMER, // PE2 ** D2
 	NOT_ON_TIMER, // PE3 ** D3
-	NOT_ON_TIMER, // PE4 ** D4	
-	NOT_ON_TIMER, // PE5 ** D5
+	NOT_ON_TIMER, // PE4 ** D4 ** SCL	
+	NOT_ON_TIMER, // PE5 ** D5 ** SDA
 	NOT_ON_TIMER, // PE6 ** D6 
 	NOT_ON_TIMER, // PE7 ** D7
 	
@@ -246,13 +253,17 @@ const uint8_t PROGMEM digital_pin_to_timer_PGM[] = {
 	TIMER0, 	    // PB4 ** D12 ** PWM
 	TIMER1A, 	    // PB5 ** D13 ** PWM
 	TIMER1B, 	    // PB6 ** D14 ** PWM	
+#ifdef MILLIS_RTC
+	NOT_ON_TIMER, // PB7 ** D15 ** Timer2 runs the RTC
+#else
 	TIMER2A,      // PB7 ** D15 ** PWM
+#endif
 	
 	NOT_ON_TIMER, // PG3 ** D16
 	NOT_ON_TIMER, // PG4 ** D17
 	
-	NOT_ON_TIMER, // PD0 ** D18 ** SCL	
-	NOT_ON_TIMER, // PD1 ** D19 ** SDA	
+	NOT_ON_TIMER, // PD0 ** D18	
+	NOT_ON_TIMER, // PD1 ** D19	
 	NOT_ON_TIMER, // PD2 ** D20 ** RX1
 	NOT_ON_TIMER, // PD3 ** D21 ** TX1	
 	NOT_ON_TIMER, // PD4 ** D22 